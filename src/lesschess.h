@@ -6,3 +6,5 @@
 #include "tt.h"
 #include "evaluate.h"
 #include "search.h"
+#include "thread.h"
+#include "perft.h"
@@ -1,7 +1,10 @@
+#include <chrono>
 #include <cstdio>
 #include <string>
 #include <iostream>
+#include <mutex>
 #include <sstream>
+#include <vector>
 #include "lesschess.h"
 
 using namespace lesschess;
@@ -184,14 +187,148 @@ std::string engine_info() {
 // 2019-08-14 16:12:18.215<--1:bestmove g8f6 ponder c2c4
 // 2019-08-14 16:12:18.215*1*Found move:Ng8-f6
 
+// guards std::cout, the search thread writes "info" and "bestmove" while
+// the UCI loop is still answering commands
+std::mutex io_mutex;
+
+void send(const std::string& msg)
+{
+    std::lock_guard<std::mutex> lock(io_mutex);
+    std::cout << msg << std::endl;
+}
+
+std::string format_info(int depth, int multipv, int score, const Line& pv, s64 nodes, s64 msecs)
+{
+    std::string ss;
+    ss += "info depth " + std::to_string(depth);
+    ss += " multipv " + std::to_string(multipv);
+    if (is_mate_score(score)) {
+        ss += " score mate " + std::to_string(mate_distance(score));
+    } else {
+        ss += " score cp " + std::to_string(score);
+    }
+    ss += " nodes " + std::to_string(nodes);
+    ss += " nps " + std::to_string(msecs > 0 ? 1000 * nodes / msecs : nodes);
+    ss += " time " + std::to_string(msecs);
+    ss += " pv";
+    for (int i = 0; i < pv.count; ++i) {
+        ss += " " + pv.moves[i].to_long_algebraic_string();
+    }
+    return ss;
+}
+
+// parse "setoption name <id> [value <x>]", <id> and <x> may contain spaces
+void parse_setoption(std::stringstream& ss, std::string& name, std::string& value)
+{
+    std::string token;
+    ss >> token;
+    if (token != "name") {
+        return;
+    }
+    while (ss >> token && token != "value") {
+        name += name.empty() ? "" : " ";
+        name += token;
+    }
+    while (ss >> token) {
+        value += value.empty() ? "" : " ";
+        value += token;
+    }
+}
+
+s64 elapsed_msecs(std::chrono::steady_clock::time_point start)
+{
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+}
+
+void print_perft_stats(Position position, int depth)
+{
+    auto start = std::chrono::steady_clock::now();
+    PerftStats stats = perft_stats(position, depth);
+    std::stringstream ss;
+    ss << stats << "Time (ms)  : " << elapsed_msecs(start);
+    send(ss.str());
+}
+
+void print_perft_divide(Position position, int depth)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::string msg;
+    u64 total = 0;
+    for (const auto& [move, nodes] : perft_divide(position, depth)) {
+        msg += move.to_long_algebraic_string() + ": " + std::to_string(nodes) + "\n";
+        total += nodes;
+    }
+    msg += "\nNodes searched: " + std::to_string(total);
+    msg += "\nTime (ms): " + std::to_string(elapsed_msecs(start));
+    send(msg);
+}
+
+void print_perft_hashed(Position position, int depth)
+{
+    auto start = std::chrono::steady_clock::now();
+    PerftCache cache;
+    u64 nodes = perft_parallel(position, depth, 0, 1, &cache);
+    std::stringstream ss;
+    ss << "Nodes searched: " << nodes
+       << "\nCache hit rate: " << 100.0 * cache.hit_rate() << "%"
+       << "\nTime (ms): " << elapsed_msecs(start);
+    send(ss.str());
+}
+
+// ./lesschess perft <fen> <depth>
+// ./lesschess hperft <fen> <depth>
+// ./lesschess divide <fen> <depth>
+int run_command(int argc, char** argv)
+{
+    const std::string command = argv[0];
+    if ((command != "perft" && command != "hperft" && command != "divide") || argc != 3) {
+        std::cerr << "Usage: ./lesschess [perft|hperft|divide] <fen> <depth>" << std::endl;
+        return 1;
+    }
+
+    Position position;
+    int depth;
+    try {
+        position = Position::from_fen(argv[1]);
+        depth = std::stoi(argv[2]);
+    } catch (const std::exception& ex) {
+        std::cerr << "invalid arguments: " << ex.what() << std::endl;
+        return 1;
+    }
+    if (depth < 1) {
+        std::cerr << "depth must be at least 1" << std::endl;
+        return 1;
+    }
+
+    if (command == "perft") {
+        print_perft_stats(position, depth);
+    } else if (command == "hperft") {
+        print_perft_hashed(position, depth);
+    } else {
+        print_perft_divide(position, depth);
+    }
+    return 0;
+}
+
 int main(int argc, char** argv)
 {
     Zobrist::initialize();
 
+    if (argc > 1) {
+        return run_command(argc - 1, argv + 1);
+    }
+
     Move move;
     Savepos sp;
-    Position position; // TODO: move to separate thread
-    SearchResult search_result;
+    Position position = Position::from_fen(start_position_fen);
+    std::vector<u64> game_hashes; // positions before `position`, for repetitions
+    TT tt;
+    ThreadPool threads;
+    s64 move_overhead = SearchLimits{}.move_overhead;
+    int multipv = SearchLimits{}.multipv;
+    int lmr_base = LMR_BASE;
+    int lmr_divisor = LMR_DIVISOR;
 
     // UCI handling
     std::string line, token;
@@ -211,7 +348,17 @@ int main(int argc, char** argv)
 
             std::cout << "id name LessChess v" << VERSION << std::endl;
             std::cout << "id author Peter Lesslie" << std::endl;
-            // TODO: implement sending options
+            std::cout << "option name Hash type spin default " << TT::DefaultSizeMB
+                      << " min " << TT::MinSizeMB << " max " << TT::MaxSizeMB << std::endl;
+            std::cout << "option name Clear Hash type button" << std::endl;
+            std::cout << "option name Threads type spin default 1 min 1 max " << ThreadPool::MaxThreads << std::endl;
+            std::cout << "option name Move Overhead type spin default " << move_overhead
+                      << " min 0 max 5000" << std::endl;
+            std::cout << "option name Ponder type check default false" << std::endl;
+            std::cout << "option name MultiPV type spin default " << multipv << " min 1 max " << MAX_MOVES
+                      << std::endl;
+            std::cout << "option name LMR Base type spin default " << lmr_base << " min 0 max 500" << std::endl;
+            std::cout << "option name LMR Divisor type spin default " << lmr_divisor << " min 50 max 1000" << std::endl;
             std::cout << "uciok" << std::endl;
         } else if (token == "debug") {
             // * debug [ on | off ]
@@ -240,8 +387,7 @@ int main(int argc, char** argv)
             // 	This command must always be answered with "readyok" and can be sent also when the engine is calculating
             // 	in which case the engine should also immediately answer with "readyok" without stopping the search.
 
-            // TODO: implement
-            std::cout << "readyok" << std::endl;
+            send("readyok");
         } else if (token == "setoption") {
             // * setoption name <id> [value <x>]
             // 	this is sent to the engine when the user wants to change the internal parameters
@@ -257,7 +403,47 @@ int main(int argc, char** argv)
             // 	   "setoption name Clear Hash\n"
             // 	   "setoption name NalimovPath value c:\chess\tb\4;c:\chess\tb\5\n"
 
-            // TODO: implement
+            std::string name, value;
+            parse_setoption(ss, name, value);
+            threads.wait();
+            if (name == "Hash") {
+                try {
+                    tt.resize(std::stoul(value));
+                } catch (const std::exception& ex) {
+                    std::cerr << "invalid Hash value: '" << value << "'" << std::endl;
+                }
+            } else if (name == "Clear Hash") {
+                tt.clear();
+            } else if (name == "Threads") {
+                try {
+                    threads.resize(std::stoi(value));
+                } catch (const std::exception& ex) {
+                    std::cerr << "invalid Threads value: '" << value << "'" << std::endl;
+                }
+            } else if (name == "Move Overhead") {
+                try {
+                    move_overhead = std::stol(value);
+                } catch (const std::exception& ex) {
+                    std::cerr << "invalid Move Overhead value: '" << value << "'" << std::endl;
+                }
+            } else if (name == "Ponder") {
+                // nothing to set up, the GUI decides when to "go ponder"
+            } else if (name == "MultiPV") {
+                try {
+                    multipv = std::clamp(std::stoi(value), 1, MAX_MOVES);
+                } catch (const std::exception& ex) {
+                    std::cerr << "invalid MultiPV value: '" << value << "'" << std::endl;
+                }
+            } else if (name == "LMR Base" || name == "LMR Divisor") {
+                try {
+                    (name == "LMR Base" ? lmr_base : lmr_divisor) = std::stoi(value);
+                    init_reductions(lmr_base, std::max(lmr_divisor, 1));
+                } catch (const std::exception& ex) {
+                    std::cerr << "invalid " << name << " value: '" << value << "'" << std::endl;
+                }
+            } else {
+                std::cerr << "Unknown option: '" << name << "'" << std::endl;
+            }
         } else if (token == "register") {
             // * register
             // 	this is the command to try to register an engine or to tell the engine that registration
@@ -286,7 +472,9 @@ int main(int argc, char** argv)
             //    As the engine's reaction to "ucinewgame" can take some time the GUI should always send "isready"
             //    after "ucinewgame" to wait for the engine to finish its operation.
 
-            // TODO: implement
+            threads.stop();
+            threads.wait();
+            tt.clear();
         } else if (token == "position") {
             // * position [fen <fenstring> | startpos ]  moves <move1> .... <movei>
             // 	set up the position described in fenstring on the internal board and
@@ -295,22 +483,30 @@ int main(int argc, char** argv)
             // 	Note: no "new" command is needed. However, if this position is from a different game than
             // 	the last position sent to the engine, the GUI should have sent a "ucinewgame" inbetween.
 
-            // TODO: implement
+            std::string fen;
             ss >> token;
             if (token == "startpos") {
-                token = start_position_fen;
-            } else if (token == "fen") {
+                fen = start_position_fen;
+                token.clear();
                 ss >> token;
+            } else if (token == "fen") {
+                // the FEN itself contains spaces, read up to "moves"
+                while (ss >> token && token != "moves") {
+                    fen += fen.empty() ? "" : " ";
+                    fen += token;
+                }
             } else {
                 std::cerr << "invalid 'position' command: expected FEN" << std::endl;
                 continue;
             }
-            position = Position::from_fen(token);
-            if (ss >> token) {
-                if (token != "moves") {
-                    std::cerr << "invalid 'position' command: expected 'moves'" << std::endl;
-                    continue;
-                }
+            try {
+                position = Position::from_fen(fen);
+                game_hashes.clear();
+            } catch (const std::exception& ex) {
+                std::cerr << "invalid FEN: " << ex.what() << std::endl;
+                continue;
+            }
+            if (token == "moves") {
                 while (ss >> token) {
                     try {
                         move = position.move_from_long_algebraic(token);
@@ -319,6 +515,7 @@ int main(int argc, char** argv)
                         // TODO: how to handle error in move?
                         exit(0);
                     }
+                    game_hashes.push_back(position.zobrist_hash());
                     position.make_move(sp, move);
                 }
             }
@@ -364,26 +561,110 @@ int main(int argc, char** argv)
             // 	* infinite
             // 		search until the "stop" command. Do not exit the search without being told so in this mode!
 
-            // TODO: implement
-            search_result = easy_search(position);
-            std::cout << "info score cp " << search_result.score << std::endl;
-            std::cout << "bestmove " << search_result.move.to_long_algebraic_string() << std::endl;
-            // TEMP TEMP
-            // std::cout << "bestmove g8f6" << std::endl;
+            SearchLimits limits;
+            limits.move_overhead = move_overhead;
+            limits.multipv = multipv;
+            while (ss >> token) {
+                if (token == "wtime") {
+                    ss >> limits.time[WHITE];
+                } else if (token == "btime") {
+                    ss >> limits.time[BLACK];
+                } else if (token == "winc") {
+                    ss >> limits.inc[WHITE];
+                } else if (token == "binc") {
+                    ss >> limits.inc[BLACK];
+                } else if (token == "movestogo") {
+                    ss >> limits.movestogo;
+                } else if (token == "movetime") {
+                    ss >> limits.movetime;
+                } else if (token == "depth") {
+                    ss >> limits.depth;
+                } else if (token == "nodes") {
+                    ss >> limits.nodes;
+                } else if (token == "mate") {
+                    ss >> limits.mate;
+                } else if (token == "infinite") {
+                    limits.infinite = true;
+                } else if (token == "ponder") {
+                    limits.ponder = true;
+                } else if (token == "searchmoves") {
+                    // the moves run up to the next option, which won't parse
+                    // as a move
+                    auto next = ss.tellg();
+                    while (ss >> token) {
+                        try {
+                            move = position.move_from_long_algebraic(token);
+                        } catch (const std::exception& ex) {
+                            ss.seekg(next);
+                            break;
+                        }
+                        if (position.is_legal_move(move)) {
+                            limits.searchmoves.push_back(move);
+                        } else {
+                            std::cerr << "illegal searchmoves move: '" << token << "'" << std::endl;
+                        }
+                        next = ss.tellg();
+                    }
+                } else {
+                    std::cerr << "Unsupported go option: '" << token << "'" << std::endl;
+                }
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            auto info = [start](int depth, int multipv, int score, const Line& pv, const SearchMetrics&,
+                    s64 nodes) {
+                auto elapsed = std::chrono::steady_clock::now() - start;
+                s64 msecs = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+                send(format_info(depth, multipv, score, pv, nodes, msecs));
+            };
+            auto done = [](const SearchResult& result, const Line& pv) {
+                // UCI's null move, for a position with no legal moves
+                if (result.move == MOVE_NONE) {
+                    send("bestmove 0000");
+                    return;
+                }
+                std::string msg = "bestmove " + result.move.to_long_algebraic_string();
+                if (pv.count > 1) {
+                    msg += " ponder " + pv.moves[1].to_long_algebraic_string();
+                }
+                send(msg);
+            };
+            threads.go(position, game_hashes, &tt, limits, info, done);
 
         } else if (token == "stop") {
             // * stop
             // 	stop calculating as soon as possible,
             // 	don't forget the "bestmove" and possibly the "ponder" token when finishing the search
 
-            // TODO: implement
+            threads.stop();
         } else if (token == "ponderhit") {
             // * ponderhit
             //     the user has played the expected move. This will be sent if the engine was told to ponder on the same move
             //     the user has played. The engine should continue searching but switch from pondering to normal search.
 
-            // TODO: implement
+            threads.ponderhit();
+        } else if (token == "perft" || token == "hperft" || token == "divide") {
+            // non-standard debugging commands, run on the current position:
+            // * perft <depth>
+            //     leaf node count with captures, e.p., castles, promotions, checks and mates
+            // * hperft <depth>
+            //     leaf node count on every core with a perft cache, and the cache hit rate
+            // * divide <depth>
+            //     leaf node count below each root move
+
+            int depth = 0;
+            ss >> depth;
+            if (depth < 1) {
+                std::cerr << "usage: " << token << " <depth>" << std::endl;
+            } else if (token == "perft") {
+                print_perft_stats(position, depth);
+            } else if (token == "hperft") {
+                print_perft_hashed(position, depth);
+            } else {
+                print_perft_divide(position, depth);
+            }
         } else if (token == "quit") {
+            threads.stop();
             break;
         } else {
             std::cerr << "Unknown command: '" << token << "'" << std::endl;
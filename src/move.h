@@ -104,8 +104,11 @@ enum { RANK_1=0, RANK_2, RANK_3, RANK_4, RANK_5, RANK_6, RANK_7, RANK_8 };
 
 constexpr u64 A_FILE = 0x101010101010101ull;
 constexpr u64 H_FILE = 0x8080808080808080ull;
+constexpr u64 FIRST_RANK = 0xffull;
 constexpr u64 SECOND_RANK = 0xff00ull;
 constexpr u64 SEVENTH_RANK = 0xff000000000000ull;
+constexpr u64 EIGHTH_RANK = 0xff00000000000000ull;
+constexpr u64 PROMOTION_RANKS = FIRST_RANK | EIGHTH_RANK;
 constexpr u64 RANK2(Color side) noexcept { return side == WHITE ? SECOND_RANK : SEVENTH_RANK; }
 
 struct Piece {
@@ -328,13 +331,18 @@ public:
     static constexpr Move make_promotion(Square from, Square to, PieceKind promotion) noexcept
     { return Move(from, to, promotion); }
 
-    static constexpr Move _make_from_u16(u16) noexcept
+    static constexpr Move _make_from_u16(u16 rep) noexcept
     {
         Move m{};
-        m.rep_ = 0u;
+        m.rep_ = rep;
         return m;
     }
 
+    [[nodiscard]]
+    constexpr u16 value() const noexcept {
+        return rep_;
+    }
+
     [[nodiscard]]
     constexpr Castle castle_kind() const noexcept {
         assert(is_castle());
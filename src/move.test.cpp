@@ -90,6 +90,14 @@ TEST_CASE("Move", "move representation construction checks") {
          REQUIRE(move.is_promotion() == true);
          REQUIRE(move.promotion() == ROOK);
      }
+
+     SECTION("Round trip through u16") {
+         constexpr auto move = Move::make_promotion(B7, A8, KNIGHT);
+         REQUIRE(Move::_make_from_u16(move.value()) == move);
+         REQUIRE(Move::_make_from_u16(Move::make_castle(Castle::BLACK_QUEEN_SIDE).value()) ==
+                 Move::make_castle(Castle::BLACK_QUEEN_SIDE));
+         REQUIRE(MOVE_NONE.value() == 0);
+     }
 }
 
 TEST_CASE("Square", "square from file, rank or value, etc") {
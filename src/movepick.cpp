@@ -0,0 +1,196 @@
+#include "movepick.h"
+#include "evaluate.h"
+#include <utility>
+
+namespace lesschess {
+
+// attackers from least to most valuable, indexed by PieceKind
+constexpr int LVA_ORDER[6] = {
+    2, // knight
+    3, // bishop
+    4, // rook
+    5, // queen
+    1, // pawn
+    6, // king
+};
+
+// added to the score of captures that lose material so they sort last
+constexpr int LOSING_CAPTURE = 1 << 20;
+
+// most valuable victim first, then least valuable attacker
+int mvv_lva(const Position& position, Move move) noexcept
+{
+    int score = 0;
+    if (move.is_enpassant()) {
+        score += 8 * BasePieceValues[PAWN];
+    } else if (position.is_capture(move)) {
+        score += 8 * BasePieceValues[position.piece_on_square(move.to()).kind()];
+    }
+    if (move.is_promotion()) {
+        score += 8 * BasePieceValues[move.promotion()];
+    }
+    return score - LVA_ORDER[position.piece_on_square(move.from()).kind()];
+}
+
+bool loses_material(const Position& position, Move move) noexcept
+{
+    // taking something worth at least as much as the attacker can't lose
+    // material, which saves running the SEE for most captures
+    if (!move.is_promotion() && !move.is_enpassant()) {
+        Piece victim = position.piece_on_square(move.to());
+        Piece attacker = position.piece_on_square(move.from());
+        if (BasePieceValues[victim.kind()] >= BasePieceValues[attacker.kind()] && attacker.kind() != KING) {
+            return false;
+        }
+    }
+    return position.see(move) < 0;
+}
+
+MovePicker::MovePicker(const Position& position, Move tt_move, const Killers& killers, Move counter,
+        const History& history) noexcept
+    : _position{position}, _history{&history}, _tt_move{tt_move},
+      _refutations{killers.moves[0], killers.moves[1], counter}, _stage{Stage::TT_MOVE}
+{
+    if (killers.contains(counter)) {
+        _refutations[2] = MOVE_NONE;
+    }
+}
+
+MovePicker::MovePicker(const Position& position) noexcept
+    : _position{position}, _stage{Stage::GENERATE}, _captures_only{true}
+{}
+
+void MovePicker::_generate_captures() noexcept
+{
+    _end_captures = _position.generate_captures(&_moves[0]);
+    _end_captures = _remove(_tt_move, 0, _end_captures);
+    _end = _end_captures;
+}
+
+void MovePicker::_generate_quiets() noexcept
+{
+    _end = _end_captures + _position.generate_quiets(&_moves[_end_captures]);
+    _end = _remove(_tt_move, _end_captures, _end);
+    for (Move refutation : _refutations) {
+        _end = _remove(refutation, _end_captures, _end);
+    }
+}
+
+int MovePicker::_remove(Move move, int first, int last) noexcept
+{
+    // the move was already returned, don't hand it out twice
+    if (move == MOVE_NONE) {
+        return last;
+    }
+    for (int i = first; i < last; ++i) {
+        if (_moves[i] == move) {
+            _moves[i] = _moves[last - 1];
+            return last - 1;
+        }
+    }
+    return last;
+}
+
+Move MovePicker::_select_best(int& cur, int end) noexcept
+{
+    assert(cur < end);
+    int best = cur;
+    for (int i = cur + 1; i < end; ++i) {
+        if (_scores[i] > _scores[best]) {
+            best = i;
+        }
+    }
+    std::swap(_moves[cur], _moves[best]);
+    std::swap(_scores[cur], _scores[best]);
+    return _moves[cur++];
+}
+
+Move MovePicker::next() noexcept
+{
+    switch (_stage) {
+    case Stage::TT_MOVE:
+        _stage = Stage::GENERATE;
+        // the TT move is tried before generating anything, when it causes a
+        // cutoff nothing else is ever generated. It has to be checked since
+        // it may be from a different position with the same hash.
+        if (_tt_move != MOVE_NONE && _position.is_valid_move(_tt_move)) {
+            return _tt_move;
+        }
+        _tt_move = MOVE_NONE;
+        [[fallthrough]];
+
+    case Stage::GENERATE:
+        _generate_captures();
+        for (int i = 0; i < _end_captures; ++i) {
+            _scores[i] = mvv_lva(_position, _moves[i]);
+            if (loses_material(_position, _moves[i])) {
+                _scores[i] -= LOSING_CAPTURE;
+            }
+        }
+        _cur = 0;
+        _stage = Stage::CAPTURES;
+        [[fallthrough]];
+
+    case Stage::CAPTURES:
+        if (_cur < _end_captures) {
+            Move move = _select_best(_cur, _end_captures);
+            if (_scores[_cur - 1] >= 0) {
+                return move;
+            }
+            // only losing captures are left, they are tried after the quiet
+            // moves, or not at all in quiescence
+            --_cur;
+        }
+        if (_captures_only) {
+            _stage = Stage::DONE;
+            return MOVE_NONE;
+        }
+        _stage = Stage::KILLERS;
+        [[fallthrough]];
+
+    case Stage::KILLERS:
+        // killers and counter moves come from other positions, so only use
+        // them if they are legal quiet moves here. Like the TT move they're
+        // tried before the quiet moves are generated. The ones that aren't
+        // used are cleared, so the rest can be left out of the quiets.
+        while (_refutation < static_cast<int>(_refutations.size())) {
+            Move& refutation = _refutations[_refutation++];
+            if (refutation != MOVE_NONE && refutation != _tt_move && !refutation.is_promotion() &&
+                    !_position.is_capture(refutation) && _position.is_valid_move(refutation)) {
+                return refutation;
+            }
+            refutation = MOVE_NONE;
+        }
+        _stage = Stage::QUIETS_INIT;
+        [[fallthrough]];
+
+    case Stage::QUIETS_INIT:
+        _generate_quiets();
+        _cur_quiet = _end_captures;
+        for (int i = _cur_quiet; i < _end; ++i) {
+            _scores[i] = _history->get(_position.color_to_move(), _moves[i]);
+        }
+        _stage = Stage::QUIETS;
+        [[fallthrough]];
+
+    case Stage::QUIETS:
+        if (_cur_quiet < _end) {
+            return _select_best(_cur_quiet, _end);
+        }
+        _stage = Stage::BAD_CAPTURES;
+        [[fallthrough]];
+
+    case Stage::BAD_CAPTURES:
+        if (_cur < _end_captures) {
+            return _select_best(_cur, _end_captures);
+        }
+        _stage = Stage::DONE;
+        [[fallthrough]];
+
+    case Stage::DONE:
+        break;
+    }
+    return MOVE_NONE;
+}
+
+} // ~namespace lesschess
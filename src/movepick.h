@@ -0,0 +1,164 @@
+#pragma once
+
+#include "position.h"
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+
+namespace lesschess {
+
+// [color][from][to] score of quiet moves, raised whenever the move causes a
+// beta cutoff and lowered when another quiet move does instead.
+struct History {
+    constexpr static int Max = 1 << 14;
+
+    // bonus for a cutoff `depth` plies from the horizon
+    static int bonus(int depth) noexcept
+    { return std::min(16 * depth * depth, Max / 4); }
+
+    int get(Color side, Move move) const noexcept
+    { return table[side][move.from().value()][move.to().value()]; }
+
+    // `bonus` is negative for a penalty. The update is scaled down as the
+    // entry gets close to +/-Max ("gravity"), so entries never saturate and
+    // moves that stop causing cutoffs drift back down.
+    void update(Color side, Move move, int bonus) noexcept
+    {
+        int& entry = table[side][move.from().value()][move.to().value()];
+        bonus = std::clamp(bonus, -Max, Max);
+        entry += bonus - entry * std::abs(bonus) / Max;
+    }
+
+    // shrink everything between searches, so what was learned is kept as a
+    // hint without drowning out the new search
+    void age() noexcept
+    {
+        for (auto& side : table) {
+            for (auto& from : side) {
+                for (int& entry : from) {
+                    entry /= 2;
+                }
+            }
+        }
+    }
+
+    void clear() noexcept
+    {
+        for (auto& side : table) {
+            for (auto& from : side) {
+                from.fill(0);
+            }
+        }
+    }
+
+    std::array<std::array<std::array<int, 64>, 64>, 2> table{};
+};
+
+// [from][to] of a move, the quiet reply that last caused a beta cutoff
+// against it.
+struct CounterMoves {
+    Move get(Move previous) const noexcept
+    {
+        if (previous == MOVE_NONE) {
+            return MOVE_NONE;
+        }
+        return table[previous.from().value()][previous.to().value()];
+    }
+
+    void update(Move previous, Move move) noexcept
+    {
+        if (previous != MOVE_NONE) {
+            table[previous.from().value()][previous.to().value()] = move;
+        }
+    }
+
+    void clear() noexcept
+    {
+        for (auto& from : table) {
+            from.fill(MOVE_NONE);
+        }
+    }
+
+    std::array<std::array<Move, 64>, 64> table{};
+};
+
+// Two most recent quiet moves that caused a beta cutoff at a given ply.
+struct Killers {
+    void update(Move move) noexcept
+    {
+        if (moves[0] != move) {
+            moves[1] = moves[0];
+            moves[0] = move;
+        }
+    }
+
+    bool contains(Move move) const noexcept
+    { return moves[0] == move || moves[1] == move; }
+
+    void clear() noexcept
+    { moves.fill(MOVE_NONE); }
+
+    std::array<Move, 2> moves{MOVE_NONE, MOVE_NONE};
+};
+
+// Hands out the legal moves of a position one at a time, in stages, so that
+// when an early move causes a cutoff the later ones are never generated,
+// scored or sorted:
+//
+//   1. the TT move
+//   2. captures and promotions that don't lose material (by SEE), by MVV-LVA
+//   3. killer moves and the counter move
+//   4. the remaining quiet moves, by history
+//   5. losing captures
+//
+// In quiescence only stage 2 is used, so losing captures are pruned.
+//
+// Within a stage the best remaining move is selected on each call instead of
+// sorting the whole stage up front.
+class MovePicker {
+public:
+    // every legal move, for the main search
+    MovePicker(const Position& position, Move tt_move, const Killers& killers, Move counter,
+            const History& history) noexcept;
+
+    // captures only, for quiescence
+    explicit MovePicker(const Position& position) noexcept;
+
+    // next move to search, MOVE_NONE when there are no more
+    [[nodiscard]]
+    Move next() noexcept;
+
+private:
+    enum class Stage {
+        TT_MOVE,
+        GENERATE,
+        CAPTURES,
+        KILLERS,
+        QUIETS_INIT,
+        QUIETS,
+        BAD_CAPTURES,
+        DONE,
+    };
+
+    void _generate_captures() noexcept;
+    void _generate_quiets() noexcept;
+    int _remove(Move move, int first, int last) noexcept;
+    Move _select_best(int& cur, int end) noexcept;
+
+    const Position& _position;
+    const History*  _history = nullptr;
+    Move            _tt_move = MOVE_NONE;
+    // killers followed by the counter move
+    std::array<Move, 3> _refutations;
+    Stage           _stage;
+    bool            _captures_only = false;
+    int             _cur = 0;
+    int             _cur_quiet = 0;
+    int             _end_captures = 0;
+    int             _end = 0;
+    int             _refutation = 0;
+    Move            _moves[MAX_MOVES];
+    int             _scores[MAX_MOVES];
+};
+
+} // ~namespace lesschess
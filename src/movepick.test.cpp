@@ -0,0 +1,148 @@
+#include "catch.hpp"
+#include "movepick.h"
+#include <algorithm>
+#include <vector>
+
+using namespace lesschess;
+
+std::vector<Move> pick_all(MovePicker& picker)
+{
+    std::vector<Move> moves;
+    for (Move move; (move = picker.next()) != MOVE_NONE; ) {
+        moves.push_back(move);
+    }
+    return moves;
+}
+
+std::vector<Move> sorted(std::vector<Move> moves)
+{
+    std::sort(moves.begin(), moves.end());
+    return moves;
+}
+
+TEST_CASE("MovePicker stages", "[movepick]")
+{
+    // white's pawn can take the queen or the rook
+    auto position = Position::from_fen("4k3/8/2r1q3/3P4/4N3/8/8/4K3 w - - 0 1");
+    Move legal[MAX_MOVES];
+    int nlegal = position.generate_legal_moves(&legal[0]);
+
+    History history;
+    history.clear();
+    Killers killers;
+    const Move tt_move = Move(E1, F1);
+    const Move killer = Move(E1, D2);
+    const Move counter = Move(E1, F2);
+    const Move good_quiet = Move(E1, E2);
+    killers.update(killer);
+    history.update(WHITE, good_quiet, 100);
+
+    MovePicker picker(position, tt_move, killers, counter, history);
+    auto moves = pick_all(picker);
+    REQUIRE(sorted(moves) == sorted(std::vector<Move>(&legal[0], &legal[nlegal])));
+
+    REQUIRE(moves.size() >= 6);
+    REQUIRE(moves[0] == tt_move);
+    REQUIRE(moves[1] == Move(D5, E6));
+    REQUIRE(moves[2] == Move(D5, C6));
+    REQUIRE(moves[3] == killer);
+    REQUIRE(moves[4] == counter);
+    REQUIRE(moves[5] == good_quiet);
+}
+
+TEST_CASE("MovePicker ignores moves that aren't legal", "[movepick]")
+{
+    auto position = Position::from_fen("4k3/8/8/8/8/8/8/4K2R w - - 0 1");
+    Move legal[MAX_MOVES];
+    int nlegal = position.generate_legal_moves(&legal[0]);
+
+    History history;
+    history.clear();
+    Killers killers;
+    killers.update(Move(A2, A4));
+    MovePicker picker(position, Move(B1, B3), killers, Move(H1, H8), history);
+    auto moves = pick_all(picker);
+    REQUIRE(sorted(moves) == sorted(std::vector<Move>(&legal[0], &legal[nlegal])));
+}
+
+TEST_CASE("MovePicker refutations", "[movepick]")
+{
+    auto position = Position::from_fen("4k3/8/2r1q3/3P4/4N3/8/8/4K3 w - - 0 1");
+    Move legal[MAX_MOVES];
+    int nlegal = position.generate_legal_moves(&legal[0]);
+
+    // a killer that is a capture here, and one that is the TT move, are
+    // each only handed out once, in their own stage. The counter move would
+    // be legal if the knight wasn't pinned.
+    History history;
+    history.clear();
+    Killers killers;
+    const Move tt_move = Move(E1, F1);
+    killers.update(tt_move);
+    killers.update(Move(D5, E6));
+    MovePicker picker(position, tt_move, killers, Move(E4, F6), history);
+    auto moves = pick_all(picker);
+    REQUIRE(sorted(moves) == sorted(std::vector<Move>(&legal[0], &legal[nlegal])));
+    REQUIRE(moves[0] == tt_move);
+    REQUIRE(moves[1] == Move(D5, E6));
+    REQUIRE(moves[2] == Move(D5, C6));
+    REQUIRE(std::find(moves.begin(), moves.end(), Move(E4, F6)) == moves.end());
+
+    const Move counter = Move(E1, D2);
+    MovePicker counter_picker(position, tt_move, killers, counter, history);
+    moves = pick_all(counter_picker);
+    REQUIRE(sorted(moves) == sorted(std::vector<Move>(&legal[0], &legal[nlegal])));
+    REQUIRE(moves[3] == counter);
+}
+
+TEST_CASE("MovePicker captures only", "[movepick]")
+{
+    auto position = Position::from_fen("4k3/8/2r1q3/3P4/4N3/8/8/R3K3 w Q - 0 1");
+    MovePicker picker(position);
+    auto moves = pick_all(picker);
+    REQUIRE(moves.size() == 2);
+    REQUIRE(moves[0] == Move(D5, E6));
+    REQUIRE(moves[1] == Move(D5, C6));
+}
+
+TEST_CASE("MovePicker losing captures", "[movepick]")
+{
+    // Qxd5 loses the queen for a knight, Nxd5 is an even trade
+    auto position = Position::from_fen("4k3/8/2p5/3n4/8/4N3/8/3QK3 w - - 0 1");
+    Move legal[MAX_MOVES];
+    int nlegal = position.generate_legal_moves(&legal[0]);
+
+    History history;
+    history.clear();
+    Killers killers;
+    MovePicker picker(position, MOVE_NONE, killers, MOVE_NONE, history);
+    auto moves = pick_all(picker);
+    REQUIRE(sorted(moves) == sorted(std::vector<Move>(&legal[0], &legal[nlegal])));
+    REQUIRE(moves.front() == Move(E3, D5));
+    REQUIRE(moves.back() == Move(D1, D5));
+
+    MovePicker qpicker(position);
+    moves = pick_all(qpicker);
+    REQUIRE(moves == std::vector<Move>{Move(E3, D5)});
+}
+
+TEST_CASE("History gravity", "[movepick]")
+{
+    History history;
+    const Move move = Move(E2, E4);
+    for (int i = 0; i < 1000; ++i) {
+        history.update(WHITE, move, History::bonus(20));
+    }
+    REQUIRE(history.get(WHITE, move) <= History::Max);
+    REQUIRE(history.get(WHITE, move) > History::Max / 2);
+    REQUIRE(history.get(BLACK, move) == 0);
+
+    // a penalty from a high score takes off more than it would from zero
+    const int before = history.get(WHITE, move);
+    history.update(WHITE, move, -History::bonus(4));
+    REQUIRE(before - history.get(WHITE, move) > History::bonus(4));
+
+    history.age();
+    REQUIRE(history.get(WHITE, move) < before / 2 + 1);
+    REQUIRE(history.get(WHITE, move) > 0);
+}
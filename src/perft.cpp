@@ -1,30 +1,35 @@
 #include "perft.h"
 #include "position.h"
+#include <algorithm>
+#include <atomic>
+#include <ostream>
+#include <thread>
 #include <vector>
 
 namespace lesschess {
 
-u64 perft_speed(Position& position, int depth) {
+template <bool BulkCount>
+u64 perft(Position& position, int depth) noexcept
+{
     assert(depth >= 0);
     if (depth == 0) {
         return 1;
     }
 
-    // XXX: consider putting on stack; or try to avoid the memory allocation
-    std::vector<Move> moves(256);
+    Move moves[MAX_MOVES];
     int nmoves = position.generate_legal_moves(&moves[0]);
-    if (depth == 1) {
-        return nmoves;
+    if (BulkCount && depth == 1) {
+        return static_cast<u64>(nmoves);
     }
 
-    uint64_t nodes = 0;
+    u64 nodes = 0;
     Savepos sp;
     for (int i = 0; i < nmoves; ++i) {
 #ifndef NDEBUG
         auto orig_position = position;
 #endif
         position.make_move(sp, moves[i]);
-        nodes += perft_speed(position, depth - 1);
+        nodes += perft<BulkCount>(position, depth - 1);
         position.undo_move(sp, moves[i]);
 #ifndef NDEBUG
         assert(position == orig_position);
@@ -33,4 +38,235 @@ u64 perft_speed(Position& position, int depth) {
     return nodes;
 }
 
+template u64 perft<true>(Position& position, int depth) noexcept;
+template u64 perft<false>(Position& position, int depth) noexcept;
+
+u64 perft_speed(Position& position, int depth) {
+    return perft<true>(position, depth);
+}
+
+bool PerftCache::probe(u64 hash, int depth, u64& nodes) const noexcept
+{
+    const Slot& s = slot(hash, depth);
+    u64 data = s.data.load(std::memory_order_relaxed);
+    u64 key  = s.key.load(std::memory_order_relaxed);
+    if ((key ^ data) != hash || static_cast<int>(data >> 56) != depth) {
+        return false;
+    }
+    nodes = data & CountMask;
+    return true;
+}
+
+void PerftCache::store(u64 hash, int depth, u64 nodes) noexcept
+{
+    assert(nodes <= CountMask);
+    assert(0 < depth && depth < 256);
+    Slot& s = slot(hash, depth);
+    const u64 data = (static_cast<u64>(depth) << 56) | (nodes & CountMask);
+    s.data.store(data, std::memory_order_relaxed);
+    s.key.store(hash ^ data, std::memory_order_relaxed);
+}
+
+void PerftCache::resize(size_t mb)
+{
+    mb = std::max<size_t>(mb, 1);
+    size_t nslots = 1;
+    while (2 * nslots * sizeof(Slot) <= mb * 1024 * 1024) {
+        nslots *= 2;
+    }
+    slots = std::vector<Slot>(nslots);
+    mask = nslots - 1;
+    clear();
+}
+
+void PerftCache::clear() noexcept
+{
+    for (auto& s : slots) {
+        s.data.store(0, std::memory_order_relaxed);
+        s.key.store(0, std::memory_order_relaxed);
+    }
+    probes.store(0, std::memory_order_relaxed);
+    hits.store(0, std::memory_order_relaxed);
+}
+
+struct PerftCacheStats {
+    u64 probes = 0;
+    u64 hits = 0;
+};
+
+u64 perft_hashed(Position& position, int depth, PerftCache& cache, PerftCacheStats& stats) noexcept
+{
+    if (depth < 2) {
+        return perft<true>(position, depth);
+    }
+
+    u64 nodes = 0;
+    const u64 hash = position.zobrist_hash();
+    ++stats.probes;
+    if (cache.probe(hash, depth, nodes)) {
+        ++stats.hits;
+        return nodes;
+    }
+
+    Move moves[MAX_MOVES];
+    int nmoves = position.generate_legal_moves(&moves[0]);
+    Savepos sp;
+    for (int i = 0; i < nmoves; ++i) {
+        position.make_move(sp, moves[i]);
+        nodes += perft_hashed(position, depth - 1, cache, stats);
+        position.undo_move(sp, moves[i]);
+    }
+    cache.store(hash, depth, nodes);
+    return nodes;
+}
+
+u64 perft_hashed(Position& position, int depth, PerftCache& cache)
+{
+    PerftCacheStats stats;
+    u64 nodes = perft_hashed(position, depth, cache, stats);
+    cache.probes.fetch_add(stats.probes, std::memory_order_relaxed);
+    cache.hits.fetch_add(stats.hits, std::memory_order_relaxed);
+    return nodes;
+}
+
+// collect the positions `depth` plies below `position`
+void split_positions(Position& position, int depth, std::vector<Position>& out)
+{
+    if (depth == 0) {
+        out.push_back(position);
+        return;
+    }
+
+    Move moves[MAX_MOVES];
+    int nmoves = position.generate_legal_moves(&moves[0]);
+    Savepos sp;
+    for (int i = 0; i < nmoves; ++i) {
+        position.make_move(sp, moves[i]);
+        split_positions(position, depth - 1, out);
+        position.undo_move(sp, moves[i]);
+    }
+}
+
+u64 perft_parallel(const Position& position, int depth, int nthreads, int split_depth, PerftCache* cache)
+{
+    assert(depth >= 0);
+    split_depth = std::clamp(split_depth, 1, std::max(depth - 1, 1));
+    if (nthreads <= 0) {
+        nthreads = std::max<int>(std::thread::hardware_concurrency(), 1);
+    }
+
+    Position root = position;
+    if (depth <= split_depth || nthreads == 1) {
+        return cache ? perft_hashed(root, depth, *cache) : perft<true>(root, depth);
+    }
+
+    std::vector<Position> work;
+    split_positions(root, split_depth, work);
+    nthreads = std::min<int>(nthreads, work.size());
+
+    std::atomic<size_t> next{0};
+    std::vector<u64> counts(nthreads, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nthreads; ++t) {
+        threads.emplace_back([&, t]() {
+            u64 nodes = 0;
+            for (size_t i = next++; i < work.size(); i = next++) {
+                Position copy = work[i];
+                if (cache) {
+                    nodes += perft_hashed(copy, depth - split_depth, *cache);
+                } else {
+                    nodes += perft<true>(copy, depth - split_depth);
+                }
+            }
+            counts[t] = nodes;
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    u64 nodes = 0;
+    for (u64 count : counts) {
+        nodes += count;
+    }
+    return nodes;
+}
+
+void perft_stats(Position& position, int depth, PerftStats& stats)
+{
+    Move moves[MAX_MOVES];
+    int nmoves = position.generate_legal_moves(&moves[0]);
+    Savepos sp;
+    for (int i = 0; i < nmoves; ++i) {
+        const Move move = moves[i];
+        if (depth == 1) {
+            ++stats.nodes;
+            if (move.is_enpassant()) {
+                ++stats.enpassants;
+                ++stats.captures;
+            } else if (move.is_castle()) {
+                ++stats.castles;
+            } else if (!position.piece_on_square(move.to()).empty()) {
+                ++stats.captures;
+            }
+            if (move.is_promotion()) {
+                ++stats.promotions;
+            }
+        }
+
+        position.make_move(sp, move);
+        if (depth == 1) {
+            if (position.in_check(position.color_to_move())) {
+                ++stats.checks;
+                Move replies[MAX_MOVES];
+                if (position.generate_legal_moves(&replies[0]) == 0) {
+                    ++stats.checkmates;
+                }
+            }
+        } else {
+            perft_stats(position, depth - 1, stats);
+        }
+        position.undo_move(sp, move);
+    }
+}
+
+PerftStats perft_stats(Position& position, int depth)
+{
+    assert(depth >= 0);
+    PerftStats stats;
+    if (depth == 0) {
+        stats.nodes = 1;
+    } else {
+        perft_stats(position, depth, stats);
+    }
+    return stats;
+}
+
+std::vector<std::pair<Move, u64>> perft_divide(Position& position, int depth)
+{
+    assert(depth >= 1);
+    std::vector<std::pair<Move, u64>> result;
+    Move moves[MAX_MOVES];
+    int nmoves = position.generate_legal_moves(&moves[0]);
+    Savepos sp;
+    for (int i = 0; i < nmoves; ++i) {
+        position.make_move(sp, moves[i]);
+        result.emplace_back(moves[i], perft<true>(position, depth - 1));
+        position.undo_move(sp, moves[i]);
+    }
+    return result;
+}
+
+std::ostream& operator<<(std::ostream& os, const PerftStats& stats)
+{
+    os << "Nodes      : " << stats.nodes << "\n"
+       << "Captures   : " << stats.captures << "\n"
+       << "E.p.       : " << stats.enpassants << "\n"
+       << "Castles    : " << stats.castles << "\n"
+       << "Promotions : " << stats.promotions << "\n"
+       << "Checks     : " << stats.checks << "\n"
+       << "Checkmates : " << stats.checkmates << "\n";
+    return os;
+}
+
 } /*lesschess*/
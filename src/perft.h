@@ -1,11 +1,114 @@
 #pragma once
 
 #include "move.h"
+#include <atomic>
+#include <iosfwd>
+#include <utility>
+#include <vector>
 
 namespace lesschess {
 
-struct Position;
+class Position;
+
+// Count the leaf nodes `depth` plies below `position`. With `BulkCount` the
+// moves at depth 1 are counted from the length of the move list rather than
+// being made and unmade. Only uses stack memory, so it measures move
+// generation and make/undo instead of the allocator.
+template <bool BulkCount>
+u64 perft(Position& position, int depth) noexcept;
 
 u64 perft_speed(Position& position, int depth);
 
+// Cache of subtree node counts keyed by zobrist hash and depth, so perft
+// counts each transposed subtree once. Like the search TT it is shared
+// between threads without locking: each slot stores `key ^ data` and a
+// torn slot simply misses.
+struct PerftCache {
+    constexpr static size_t DefaultSizeMB = 64;
+
+    PerftCache(size_t mb=DefaultSizeMB)
+    { resize(mb); }
+
+    // Returns true and sets `nodes` if the subtree `depth` plies below
+    // `hash` has been counted before.
+    bool probe(u64 hash, int depth, u64& nodes) const noexcept;
+
+    void store(u64 hash, int depth, u64 nodes) noexcept;
+
+    // Reallocate to the largest power-of-two number of slots that fits in
+    // `mb` megabytes. Clears all entries and statistics.
+    void resize(size_t mb);
+
+    void clear() noexcept;
+
+    // probes that found an entry, out of all probes since the last clear()
+    double hit_rate() const noexcept
+    {
+        const u64 n = probes.load(std::memory_order_relaxed);
+        return n == 0 ? 0.0 : static_cast<double>(hits.load(std::memory_order_relaxed)) / n;
+    }
+
+    size_t size_in_bytes() const noexcept
+    { return slots.size() * sizeof(Slot); }
+
+    //
+    // data layout:
+    //   bits  0-55: node count
+    //   bits 56-63: depth
+    //
+    constexpr static u64 CountMask = (1ull << 56) - 1;
+
+    struct Slot {
+        std::atomic<u64> key; // hash ^ data
+        std::atomic<u64> data;
+    };
+
+    Slot& slot(u64 hash, int depth) noexcept
+    { return slots[(hash ^ (depth * 0x9e3779b97f4a7c15ull)) & mask]; }
+
+    const Slot& slot(u64 hash, int depth) const noexcept
+    { return slots[(hash ^ (depth * 0x9e3779b97f4a7c15ull)) & mask]; }
+
+    std::vector<Slot> slots;
+    u64 mask = 0;
+
+    // updated once per perft call, not per probe
+    std::atomic<u64> probes{0};
+    std::atomic<u64> hits{0};
+};
+
+// Bulk-counting perft that looks up and stores subtrees of depth 2 and up
+// in `cache`.
+u64 perft_hashed(Position& position, int depth, PerftCache& cache);
+
+// Bulk-counting perft spread over `nthreads` threads (0 means one per core).
+// The tree is split into the positions `split_depth` plies below the root,
+// and each thread takes the next unclaimed one with its own copy of the
+// position until none are left. All threads share `cache` if one is given.
+u64 perft_parallel(const Position& position, int depth, int nthreads=0, int split_depth=1,
+        PerftCache* cache=nullptr);
+
+// Counts of the kinds of moves made at the last ply, and of the leaf
+// positions that are check or checkmate, as listed on
+// https://www.chessprogramming.org/Perft_Results
+struct PerftStats {
+    u64 nodes = 0;
+    u64 captures = 0;
+    u64 enpassants = 0;
+    u64 castles = 0;
+    u64 promotions = 0;
+    u64 checks = 0;
+    u64 checkmates = 0;
+};
+
+std::ostream& operator<<(std::ostream& os, const PerftStats& stats);
+
+// Perft that also fills in the PerftStats counters, much slower than
+// perft_speed() because every leaf has to be made.
+PerftStats perft_stats(Position& position, int depth);
+
+// Node count below each legal root move, for comparing against another
+// engine's "divide" to find the move where a count goes wrong.
+std::vector<std::pair<Move, u64>> perft_divide(Position& position, int depth);
+
 } /*lesschess*/
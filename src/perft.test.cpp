@@ -231,3 +231,106 @@ PERFT_TEST(
     P(5, 7594526),
     P(6, 179862938),
 )
+
+TEST_CASE("bulk counting", "[perft]")
+{
+    // kiwipete: castling, en passant and promotions all show up by depth 3
+    const char* fen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+    Position position = Position::from_fen(fen);
+    for (int depth = 0; depth <= 3; ++depth) {
+        REQUIRE(perft<true>(position, depth) == perft<false>(position, depth));
+    }
+    REQUIRE(perft<false>(position, 3) == 97862);
+    REQUIRE(position == Position::from_fen(fen));
+}
+
+TEST_CASE("parallel perft", "[perft]")
+{
+    const char* fen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+    Position position = Position::from_fen(fen);
+    REQUIRE(perft_parallel(position, 0, 4) == 1);
+    REQUIRE(perft_parallel(position, 1, 4) == 48);
+    REQUIRE(perft_parallel(position, 4, 4) == 4085603);
+    REQUIRE(perft_parallel(position, 4, 3, 2) == 4085603);
+    REQUIRE(perft_parallel(position, 4, 2, 3) == 4085603);
+    REQUIRE(position == Position::from_fen(fen));
+}
+
+// too slow to run by default: ./perft "[deep]"
+TEST_CASE("starting-position deep", "[.][perft][deep]")
+{
+    Position position = Position::from_fen(start_position_fen);
+    REQUIRE(perft_parallel(position, 7, 0, 2) == 3195901860ull);
+}
+
+TEST_CASE("hashed perft", "[perft]")
+{
+    Zobrist::initialize();
+    const char* fen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+    Position position = Position::from_fen(fen);
+    PerftCache cache{1};
+    REQUIRE(cache.size_in_bytes() == 1024 * 1024);
+    REQUIRE(cache.hit_rate() == 0.0);
+
+    REQUIRE(perft_hashed(position, 4, cache) == 4085603);
+    REQUIRE(cache.hit_rate() > 0.0);
+    REQUIRE(position == Position::from_fen(fen));
+
+    // a second run is answered straight from the root entry
+    REQUIRE(perft_hashed(position, 4, cache) == 4085603);
+
+    cache.clear();
+    REQUIRE(cache.hit_rate() == 0.0);
+    REQUIRE(perft_parallel(position, 5, 4, 2, &cache) == 193690690);
+    REQUIRE(cache.hit_rate() > 0.0);
+}
+
+TEST_CASE("perft statistics", "[perft]")
+{
+    PerftStats stats;
+    Position position = Position::from_fen(start_position_fen);
+    stats = perft_stats(position, 3);
+    REQUIRE(stats.nodes == 8902);
+    REQUIRE(stats.captures == 34);
+    REQUIRE(stats.enpassants == 0);
+    REQUIRE(stats.castles == 0);
+    REQUIRE(stats.promotions == 0);
+    REQUIRE(stats.checks == 12);
+    REQUIRE(stats.checkmates == 0);
+
+    position = Position::from_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+    stats = perft_stats(position, 3);
+    REQUIRE(stats.nodes == 97862);
+    REQUIRE(stats.captures == 17102);
+    REQUIRE(stats.enpassants == 45);
+    REQUIRE(stats.castles == 3162);
+    REQUIRE(stats.promotions == 0);
+    REQUIRE(stats.checks == 993);
+    REQUIRE(stats.checkmates == 1);
+
+    position = Position::from_fen("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1");
+    stats = perft_stats(position, 4);
+    REQUIRE(stats.nodes == 43238);
+    REQUIRE(stats.captures == 3348);
+    REQUIRE(stats.enpassants == 123);
+    REQUIRE(stats.castles == 0);
+    REQUIRE(stats.promotions == 0);
+    REQUIRE(stats.checks == 1680);
+    REQUIRE(stats.checkmates == 17);
+}
+
+TEST_CASE("perft divide", "[perft]")
+{
+    Position position = Position::from_fen(start_position_fen);
+    auto divide = perft_divide(position, 3);
+    REQUIRE(divide.size() == 20);
+    u64 total = 0;
+    for (const auto& [move, nodes] : divide) {
+        total += nodes;
+        if (move == Move(E2, E4)) {
+            REQUIRE(nodes == 600);
+        }
+    }
+    REQUIRE(total == 8902);
+    REQUIRE(position == Position::from_fen(start_position_fen));
+}
@@ -5,6 +5,8 @@
 #include <cstdio>
 #include <cinttypes>
 #include "detail/magic_tables.generated.h"
+#include "evaluate.h"
+#include <algorithm>
 
 namespace lesschess {
 
@@ -715,8 +717,6 @@ void Position::make_move(Savepos& sp, Move move) noexcept {
         ++_moves;
     }
 
-    _hashs.push_front(_hash);
-
     _validate();
 }
 
@@ -829,7 +829,38 @@ void Position::undo_move(const Savepos& save, Move move) noexcept {
         assert(0);
         __builtin_unreachable();
     }
-    _hashs.pop_front();
+    _validate();
+}
+
+void Position::make_null_move(Savepos& sp) noexcept {
+    _validate();
+    assert(!in_check(wtm()));
+
+    sp.halfmoves = _halfmoves;
+    sp.ep_target = _ep_target;
+    sp.castle_rights = _castle_rights;
+    sp.captured = NO_PIECE;
+    _hash ^= Zobrist::side_to_move();
+    if (enpassant_available()) {
+        _hash ^= Zobrist::enpassant(enpassant_target_square());
+    }
+    _ep_target = ENPASSANT_NONE;
+    _wtm = flip_color(wtm());
+    _halfmoves = 0;
+
+    _validate();
+}
+
+void Position::undo_null_move(const Savepos& save) noexcept {
+    _validate();
+
+    _wtm = flip_color(wtm());
+    _hash ^= Zobrist::side_to_move();
+    _ep_target = save.ep_target;
+    if (enpassant_available()) {
+        _hash ^= Zobrist::enpassant(enpassant_target_square());
+    }
+    _halfmoves = save.halfmoves;
 
     _validate();
 }
@@ -852,7 +883,8 @@ bool Position::operator==(const Position& rhs) const noexcept {
 bool Position::operator!=(const Position& rhs) const noexcept
 { return !(*this == rhs); }
 
-int Position::generate_legal_moves(Move* moves) const noexcept
+template <Position::GenType Gen>
+int Position::_generate_legal(Move* moves) const noexcept
 {
     Color side = wtm();
     Square ksq = _kings[side];
@@ -861,7 +893,7 @@ int Position::generate_legal_moves(Move* moves) const noexcept
 
     Move* cur = moves;
     Move* end = checkers != 0 ?
-        _generate_evasions(checkers, moves) : _generate_non_evasions(moves);
+        _generate_evasions<Gen>(checkers, moves) : _generate_non_evasions<Gen>(moves);
 
     auto must_double_check = [&](Move move) {
         // need to double check legality if:
@@ -885,20 +917,19 @@ int Position::generate_legal_moves(Move* moves) const noexcept
     return (int)(end - moves);
 }
 
+int Position::generate_legal_moves(Move* moves) const noexcept
+{
+    return _generate_legal<GenType::kAll>(moves);
+}
+
 int Position::generate_captures(Move* moves) const noexcept
 {
-    Move* cur = moves;
-    int nmoves = generate_legal_moves(moves);
-    Move* end = cur + nmoves;
-    while (cur != end) {
-        // TODO: check this
-        if (cur->is_enpassant() || !piece_on_square(cur->to()).empty()) {
-            ++cur;
-        } else {
-            *cur = *(--end);
-        }
-    }
-    return (int)(end - moves);
+    return _generate_legal<GenType::kCaptures>(moves);
+}
+
+int Position::generate_quiets(Move* moves) const noexcept
+{
+    return _generate_legal<GenType::kQuiets>(moves);
 }
 
 u64 Position::_generate_attacked(Color side) const noexcept
@@ -964,6 +995,7 @@ u64 Position::_generate_attacked(Color side) const noexcept
     return rval;
 }
 
+template <Position::GenType Gen>
 Move* Position::_generate_evasions(u64 checkers, Move* moves) const noexcept
 {
     assert(checkers != 0 && "_generate_evasions should only be called if in check");
@@ -978,6 +1010,11 @@ Move* Position::_generate_evasions(u64 checkers, Move* moves) const noexcept
     Square ksq = _kings[side];
     u64 attacked = _generate_attacked(contra);
     u64 safe = ~_sidemask[side] & ~attacked;
+    if constexpr (Gen == GenType::kCaptures) {
+        safe &= _sidemask[contra];
+    } else if constexpr (Gen == GenType::kQuiets) {
+        safe &= ~_sidemask[contra];
+    }
 
     // generate king moves to squares that are not under attack
     moves = _generate_king_moves(ksq, safe, moves);
@@ -988,7 +1025,9 @@ Move* Position::_generate_evasions(u64 checkers, Move* moves) const noexcept
     }
 
     assert(more_than_one_piece(checkers) == false);
-    u64 targets = checkers;
+    // captures of the checker go in `targets`, blocks in `blocks`
+    u64 targets = Gen != GenType::kQuiets ? checkers : 0;
+    u64 blocks = 0;
     Square check_square = lsb(checkers);
     Piece  check_piece = piece_on_square(check_square);
     u64 pawns = _bboard(side, PAWN);
@@ -999,7 +1038,7 @@ Move* Position::_generate_evasions(u64 checkers, Move* moves) const noexcept
     u64 occupied = _occupied();
 
     if (check_piece.kind() == PAWN) {
-        if (_ep_target != Position::ENPASSANT_NONE && _ep_capture_square() == check_square) {
+        if (Gen != GenType::kQuiets && _ep_target != Position::ENPASSANT_NONE && _ep_capture_square() == check_square) {
             // capture left
             if (_ep_target != H6 && _ep_target != H3) {
                 int from = side == WHITE ? _ep_target - 7 : _ep_target + 9;
@@ -1019,9 +1058,15 @@ Move* Position::_generate_evasions(u64 checkers, Move* moves) const noexcept
     } else if (check_piece.kind() != KNIGHT) {
         u64 between = between_sqs(check_square.value(), ksq.value());
 
-        // try to advance pawns 1 square to block
+        // try to advance pawns 1 square to block, blocking on the last rank
+        // is a promotion
         {
             u64 posmoves = (side == WHITE ? pawns << 8 : pawns >> 8) & between;
+            if constexpr (Gen == GenType::kCaptures) {
+                posmoves &= PROMOTION_RANKS;
+            } else if constexpr (Gen == GenType::kQuiets) {
+                posmoves &= ~PROMOTION_RANKS;
+            }
             for (int tosq : PossibleMoves{posmoves}) {
                 int frsq = pawn_backward(side, tosq);
                 assert(piece_on_square(frsq) == Piece(side, PAWN));
@@ -1030,7 +1075,7 @@ Move* Position::_generate_evasions(u64 checkers, Move* moves) const noexcept
         }
 
         // for rank 2 pawns, try advancing 2 squares
-        {
+        if constexpr (Gen != GenType::kCaptures) {
             u64 posmoves = pawns & RANK2(side);
             posmoves = (side == WHITE ? posmoves << 16 : posmoves >> 16) & between;
             for (int tosq : PossibleMoves{posmoves}) {
@@ -1044,15 +1089,17 @@ Move* Position::_generate_evasions(u64 checkers, Move* moves) const noexcept
         }
 
         // includes blockers in target squares (because checker isn't a knight or pawn)
-        targets |= between;
+        if constexpr (Gen != GenType::kCaptures) {
+            blocks = between;
+        }
     }
 
-    moves = _generate_knight_moves(knights, targets, moves);
-    moves = _generate_bishop_moves(bishops | queens, occupied, targets, moves);
-    moves = _generate_rook_moves(rooks | queens, occupied, targets, moves);
+    moves = _generate_knight_moves(knights, targets | blocks, moves);
+    moves = _generate_bishop_moves(bishops | queens, occupied, targets | blocks, moves);
+    moves = _generate_rook_moves(rooks | queens, occupied, targets | blocks, moves);
 
     // capture left
-    {
+    if constexpr (Gen != GenType::kQuiets) {
         u64 posmoves = pawns & ~A_FILE;
         posmoves = (side == WHITE ? posmoves << 7 : posmoves >> 9) & checkers;
         for (int tosq : PossibleMoves{posmoves}) {
@@ -1063,7 +1110,7 @@ Move* Position::_generate_evasions(u64 checkers, Move* moves) const noexcept
     }
 
     // capture right
-    {
+    if constexpr (Gen != GenType::kQuiets) {
         u64 posmoves = pawns & ~H_FILE;
         posmoves = (side == WHITE ? posmoves << 9 : posmoves >> 7) & checkers;
         for (int tosq : PossibleMoves{posmoves}) {
@@ -1076,6 +1123,7 @@ Move* Position::_generate_evasions(u64 checkers, Move* moves) const noexcept
     return moves;
 }
 
+template <Position::GenType Gen>
 Move* Position::_generate_non_evasions(Move* moves) const noexcept
 {
     Color side = wtm();
@@ -1083,6 +1131,11 @@ Move* Position::_generate_non_evasions(Move* moves) const noexcept
     u64 occupied = _occupied();
     u64 targets = _sidemask[contra];
     u64 opp_or_empty = ~_sidemask[side];
+    if constexpr (Gen == GenType::kCaptures) {
+        opp_or_empty = targets;
+    } else if constexpr (Gen == GenType::kQuiets) {
+        opp_or_empty = ~occupied;
+    }
     u64 knights = _bboard(side, KNIGHT);
     u64 bishops = _bboard(side, BISHOP);
     u64 rooks   = _bboard(side, ROOK);
@@ -1094,11 +1147,18 @@ Move* Position::_generate_non_evasions(Move* moves) const noexcept
     moves = _generate_bishop_moves(bishops | queens, occupied, opp_or_empty, moves);
     moves = _generate_rook_moves(rooks | queens, occupied, opp_or_empty, moves);
     moves = _generate_king_moves(ksq, opp_or_empty, moves);
-    moves = _generate_castle_moves(side, ksq, moves);
+    if constexpr (Gen != GenType::kCaptures) {
+        moves = _generate_castle_moves(side, ksq, moves);
+    }
 
-    // 1-square pawn moves
+    // 1-square pawn moves, only promotions count as captures
     {
         u64 posmoves = (side == WHITE ? pawns << 8 : pawns >> 8) & ~occupied;
+        if constexpr (Gen == GenType::kCaptures) {
+            posmoves &= PROMOTION_RANKS;
+        } else if constexpr (Gen == GenType::kQuiets) {
+            posmoves &= ~PROMOTION_RANKS;
+        }
         for (int tosq : PossibleMoves{posmoves}) {
             int frsq = pawn_backward(side, tosq);
             assert(piece_on_square(frsq) == Piece(side, PAWN));
@@ -1107,7 +1167,7 @@ Move* Position::_generate_non_evasions(Move* moves) const noexcept
     }
 
     // 2-square pawn moves
-    {
+    if constexpr (Gen != GenType::kCaptures) {
         u64 posmoves = pawns & RANK2(side);
         posmoves = (side == WHITE ? posmoves << 16 : posmoves >> 16) & ~occupied;
         for (int tosq : PossibleMoves{posmoves}) {
@@ -1120,7 +1180,7 @@ Move* Position::_generate_non_evasions(Move* moves) const noexcept
     }
 
     // pawn capture left
-    {
+    if constexpr (Gen != GenType::kQuiets) {
         u64 posmoves = pawns & ~A_FILE;
         posmoves = (side == WHITE ? posmoves << 7 : posmoves >> 9) & targets;
         for (int tosq : PossibleMoves{posmoves}) {
@@ -1132,7 +1192,7 @@ Move* Position::_generate_non_evasions(Move* moves) const noexcept
     }
 
     // pawn capture right
-    {
+    if constexpr (Gen != GenType::kQuiets) {
         u64 posmoves = pawns & ~H_FILE;
         posmoves = (side == WHITE ? posmoves << 9 : posmoves >> 7) & targets;
         for (int tosq : PossibleMoves{posmoves}) {
@@ -1144,7 +1204,7 @@ Move* Position::_generate_non_evasions(Move* moves) const noexcept
     }
 
     // en passant captures
-    if (_ep_target != Position::ENPASSANT_NONE) {
+    if (Gen != GenType::kQuiets && _ep_target != Position::ENPASSANT_NONE) {
         assert(piece_on_square(_ep_target).empty() == true);
 
         // capture left
@@ -1314,8 +1374,7 @@ constexpr int castles_king_square(Move m) noexcept
 bool Position::is_legal_move(Move move) const noexcept
 {
     // very straight forward stupid implementation for now
-    static Move moves[256];
-    memset(&moves[0], 0, sizeof(Move)*256);
+    Move moves[MAX_MOVES];
     int nmoves = generate_legal_moves(&moves[0]);
     for (int i = 0; i < nmoves; ++i) {
         if (move == moves[i]) {
@@ -1325,6 +1384,67 @@ bool Position::is_legal_move(Move move) const noexcept
     return false;
 }
 
+bool Position::is_valid_move(Move move) const noexcept
+{
+    if (move == MOVE_NONE) {
+        return false;
+    }
+    // castling and check evasions have enough special cases that they're
+    // left to the move generator
+    if (move.is_castle() || in_check(wtm())) {
+        return is_legal_move(move);
+    }
+    return _is_pseudo_legal(move) && _is_legal(_generate_pinned(wtm(), wtm()), move);
+}
+
+bool Position::_is_pseudo_legal(Move move) const noexcept
+{
+    const Color side = wtm();
+    const Square from = move.from();
+    const Square to = move.to();
+    const Piece piece = piece_on_square(from);
+    const Piece target = piece_on_square(to);
+    if (piece.empty() || piece.color() != side) {
+        return false;
+    }
+    if (!target.empty() && (target.color() == side || target.kind() == KING)) {
+        return false;
+    }
+
+    const u64 occupied = _occupied();
+    if (piece.kind() != PAWN) {
+        if (move.flags() != Move::Flags::NONE) {
+            return false;
+        }
+        u64 attacks;
+        switch (piece.kind()) {
+            case KNIGHT: attacks = knight_attacks(from.value()); break;
+            case BISHOP: attacks = bishop_attacks(from.value(), occupied); break;
+            case ROOK:   attacks = rook_attacks(from.value(), occupied); break;
+            case QUEEN:  attacks = bishop_attacks(from.value(), occupied) | rook_attacks(from.value(), occupied); break;
+            default:     attacks = king_attacks(from.value()); break;
+        }
+        return (attacks & to.mask()) != 0;
+    }
+
+    if (move.is_enpassant()) {
+        return enpassant_available() && to == enpassant_target_square() &&
+            (pawn_attacks(side, from.value()) & to.mask()) != 0;
+    }
+    // a pawn reaching the last rank has to promote, and nothing else can
+    if (move.is_promotion() != ((to.mask() & PROMOTION_RANKS) != 0)) {
+        return false;
+    }
+    if (!target.empty()) {
+        return (pawn_attacks(side, from.value()) & to.mask()) != 0;
+    }
+    if (to.value() == pawn_forward(side, from.value())) {
+        return true;
+    }
+    return to.value() == pawn_forward(side, from.value(), 2) && (from.mask() & RANK2(side)) != 0 &&
+        (occupied & Square(pawn_forward(side, from.value())).mask()) == 0;
+}
+
 bool Position::attacks(Color side, Square square) const noexcept
 {
     Color contra = flip_color(side);
@@ -1355,21 +1475,103 @@ bool Position::attacks(Color side, Square square) const noexcept
     return false;
 }
 
-bool Position::is_repetition() const noexcept
+u64 Position::_attackers_to(Square square, u64 occupied) const noexcept
 {
-    // max ply that need to look back is the same logic
-    // as the 50-move rule: if a capture happens, then can't repeat,
-    // if a pawn moves, also can't repeat past that point.
-    assert(!_hashs.empty());
-    assert(_hashs.size() > _halfmoves);
-    auto it = _hashs.begin();
-    auto curr = *it++;
-    for (int ply = 0; ply < _halfmoves; ++ply) {
-        assert(it != _hashs.end());
-        if (*it == curr)
-            return true;
+    int sq = square.value();
+    u64 queens  = _bboard(WHITE, QUEEN)  | _bboard(BLACK, QUEEN);
+    u64 rooks   = _bboard(WHITE, ROOK)   | _bboard(BLACK, ROOK);
+    u64 bishops = _bboard(WHITE, BISHOP) | _bboard(BLACK, BISHOP);
+    u64 knights = _bboard(WHITE, KNIGHT) | _bboard(BLACK, KNIGHT);
+    u64 kings   = _kings[WHITE].mask()   | _kings[BLACK].mask();
+    return (rook_attacks(sq, occupied)   & (queens | rooks))   |
+           (bishop_attacks(sq, occupied) & (queens | bishops)) |
+           (knight_attacks(sq)           & knights)            |
+           (king_attacks(sq)             & kings)              |
+           (pawn_attacks(BLACK, sq)      & _bboard(WHITE, PAWN)) |
+           (pawn_attacks(WHITE, sq)      & _bboard(BLACK, PAWN));
+}
+
+int Position::see(Move move) const noexcept
+{
+    if (move.is_castle()) {
+        return 0;
     }
-    return false;
+
+    // least valuable first
+    constexpr PieceKind attacker_order[] = { PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING };
+
+    Square from = move.from();
+    Square to = move.to();
+    Color side = wtm();
+    u64 occupied = _occupied() ^ from.mask();
+    u64 queens  = _bboard(WHITE, QUEEN)  | _bboard(BLACK, QUEEN);
+    u64 rooks   = _bboard(WHITE, ROOK)   | _bboard(BLACK, ROOK)   | queens;
+    u64 bishops = _bboard(WHITE, BISHOP) | _bboard(BLACK, BISHOP) | queens;
+
+    // gain[d] is the score for the side making capture d if the sequence
+    // stopped there
+    int gain[32];
+    int d = 0;
+    int on_square; // value of the piece that will be captured next
+    if (move.is_enpassant()) {
+        gain[0] = BasePieceValues[PAWN];
+        occupied ^= Square(pawn_backward(side, to.value())).mask();
+    } else {
+        Piece captured = piece_on_square(to);
+        gain[0] = captured.empty() ? 0 : BasePieceValues[captured.kind()];
+    }
+    if (move.is_promotion()) {
+        gain[0] += BasePieceValues[move.promotion()] - BasePieceValues[PAWN];
+        on_square = BasePieceValues[move.promotion()];
+    } else {
+        on_square = BasePieceValues[piece_on_square(from).kind()];
+    }
+
+    u64 attackers = _attackers_to(to, occupied) & occupied;
+    side = flip_color(side);
+    while (d < 31) {
+        u64 ours = attackers & _sidemask[side];
+        if (ours == 0) {
+            break;
+        }
+
+        PieceKind kind = KING;
+        u64 candidates = 0;
+        for (PieceKind k : attacker_order) {
+            candidates = ours & (k == KING ? _kings[side].mask() : _bboard(side, k));
+            if (candidates != 0) {
+                kind = k;
+                break;
+            }
+        }
+
+        // the king can only take if the square is no longer defended
+        if (kind == KING && (attackers & _sidemask[flip_color(side)]) != 0) {
+            break;
+        }
+
+        ++d;
+        gain[d] = on_square - gain[d - 1];
+        on_square = kind == KING ? 0 : BasePieceValues[kind];
+
+        // remove the attacker and add any sliders it was hiding
+        occupied ^= Square(lsb(candidates)).mask();
+        if (kind == PAWN || kind == BISHOP || kind == QUEEN) {
+            attackers |= bishop_attacks(to.value(), occupied) & bishops;
+        }
+        if (kind == ROOK || kind == QUEEN) {
+            attackers |= rook_attacks(to.value(), occupied) & rooks;
+        }
+        attackers &= occupied;
+        side = flip_color(side);
+    }
+
+    // each side can choose not to recapture
+    while (d > 0) {
+        gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+        --d;
+    }
+    return gain[0];
 }
 
 // checks a pseudo-legal move for legality
@@ -4,12 +4,15 @@
 #include <string_view>
 #include <array>
 #include "move.h"
-#include "ring_buffer.h"
 
 namespace lesschess {
 
 const std::string start_position_fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 
+// upper bound on the number of legal moves in any position, the most known
+// is 218 so this is enough to generate into a stack buffer
+constexpr int MAX_MOVES = 256;
+
 struct Savepos {
     u8 halfmoves;
     u8 ep_target;
@@ -122,6 +125,13 @@ public:
 
     void undo_move(const Savepos& sp, Move move) noexcept;
 
+    // Pass the turn to the other side, for null-move pruning. Not legal when
+    // in check. Resets the fifty move counter, so repetitions aren't looked
+    // for across the null move.
+    void make_null_move(Savepos& sp) noexcept;
+
+    void undo_null_move(const Savepos& sp) noexcept;
+
     [[nodiscard]]
     Square enpassant_target_square() const noexcept
     { assert(enpassant_available()); return Square(_ep_target); }
@@ -141,6 +151,12 @@ public:
         return Piece(_sq2pc[square]);
     }
 
+    // en passant, or a move onto an enemy piece. Castling is encoded as the
+    // king moving onto its own rook, which isn't a capture.
+    [[nodiscard]]
+    bool is_capture(Move move) const noexcept
+    { return move.is_enpassant() || (!move.is_castle() && !piece_on_square(move.to()).empty()); }
+
     [[nodiscard]]
     bool white_to_move() const noexcept
     { return _wtm == WHITE; }
@@ -179,21 +195,40 @@ public:
     // template <class OutputIter>
     // OutputIter generate_legal_moves(OutputIter) const noexcept;
 
+    // `moves` must have room for MAX_MOVES moves
     [[nodiscard]]
     int generate_legal_moves(Move* moves) const noexcept;
 
+    // captures, including en passant, and promotions
     [[nodiscard]]
     int generate_captures(Move* moves) const noexcept;
 
+    // every legal move that generate_captures() doesn't return
+    [[nodiscard]]
+    int generate_quiets(Move* moves) const noexcept;
+
     [[nodiscard]]
     bool in_check(Color side) const noexcept
     { return _generate_checkers(side) != 0; }
 
+    // Static exchange evaluation: the material the side to move expects to
+    // win (or lose, if negative) by playing `move`, assuming both sides then
+    // recapture on the target square with their least valuable attacker for
+    // as long as it pays to. Pins and checks are ignored.
+    [[nodiscard]]
+    int see(Move move) const noexcept;
+
     // strict legality checking of a move, for checking is a user
     // input move is legal or not
     [[nodiscard]]
     bool is_legal_move(Move move) const noexcept;
 
+    // Same answer as is_legal_move(), but without generating every move.
+    // For moves that come from another position with the same hash (the TT)
+    // or from a sibling (killers), which are usually legal.
+    [[nodiscard]]
+    bool is_valid_move(Move move) const noexcept;
+
     [[nodiscard]]
     bool attacks(Color side, Square square) const noexcept;
 
@@ -205,6 +240,11 @@ public:
     int piece_count(Color c, PieceKind p) const noexcept
     { return popcountll(_bboard(c, p)); }
 
+    // true if `side` has anything besides pawns and the king
+    [[nodiscard]]
+    bool has_non_pawn_material(Color side) const noexcept
+    { return (_bboard(side, KNIGHT) | _bboard(side, BISHOP) | _bboard(side, ROOK) | _bboard(side, QUEEN)) != 0; }
+
     u64 zobrist_hash() const noexcept
     { return _hash; }
 
@@ -225,17 +265,6 @@ public:
         return { _ep_target };
     }
 
-    bool is_repetition() const noexcept;
-
-    // TEMP TEMP
-    void dump_hashes() const noexcept
-    {
-        std::cout << "Zobrist Hashes: ";
-        for (auto h : _hashs)
-            std::cout << h << " ";
-        std::cout << std::endl;
-    }
-
 private:
     enum {
         ENPASSANT_NONE = Square::INVALID,
@@ -281,19 +310,33 @@ private:
     static Move* _generate_rook_moves(u64 rooks, u64 occupied, u64 targets, Move* moves) noexcept;
     static Move* _generate_king_moves(Square ksq, u64 targets, Move* moves) noexcept;
     Move* _generate_castle_moves(Color side, Square ksq, Move* moves) const noexcept;
-    // bitboard of pieces from `side` that are blocking checking on `kingcolor` king
+    // which subset of the legal moves the generators produce
+    enum class GenType {
+        kAll,
+        kCaptures,
+        kQuiets,
+    };
+
+    template <GenType Gen>
+    int _generate_legal(Move* moves) const noexcept;
+    template <GenType Gen>
     Move* _generate_evasions(u64 checkers, Move* moves) const noexcept;
+    template <GenType Gen>
     Move* _generate_non_evasions(Move* moves) const noexcept;
+    // bitboard of pieces from `side` that are blocking checking on `kingcolor` king
     u64 _generate_pinned(Color side, Color kingcolor) const noexcept;
     u64 _generate_attacked(Color side) const noexcept;
     u64 _generate_checkers(Color side) const noexcept;
+    // could `move` be generated here, ignoring pins and checks
+    bool _is_pseudo_legal(Move move) const noexcept;
+    // pieces of both colors attacking `square` when only `occupied` block
+    u64 _attackers_to(Square square, u64 occupied) const noexcept;
 
 private:
     std::array<u64, 10>   _boards;
     std::array<u64, 2>    _sidemask;
     std::array<Piece, 64> _sq2pc;
     std::array<Square, 2> _kings;
-    RingBuffer<u64, 50>   _hashs; // TODO: size up to 64?
     u64 _hash;
     u16 _moves;
     u8 _halfmoves;
@@ -2325,23 +2325,181 @@ TEST_CASE("zobrist", "[position]")
     }
 }
 
-TEST_CASE("is_repetition", "[position]")
+// walk the tree checking that captures + quiets is exactly the legal moves
+void check_capture_quiet_split(Position& position, int depth)
 {
-    Position position = Position::from_fen(start_position_fen);
+    std::vector<Move> legal(MAX_MOVES), captures(MAX_MOVES), quiets(MAX_MOVES);
+    legal.resize(position.generate_legal_moves(legal.data()));
+    captures.resize(position.generate_captures(captures.data()));
+    quiets.resize(position.generate_quiets(quiets.data()));
+
+    for (Move move : captures) {
+        REQUIRE((position.is_capture(move) || move.is_promotion()));
+    }
+    for (Move move : quiets) {
+        REQUIRE(!(position.is_capture(move) || move.is_promotion()));
+    }
+    std::vector<Move> both = captures;
+    both.insert(both.end(), quiets.begin(), quiets.end());
+    std::sort(both.begin(), both.end());
+    std::sort(legal.begin(), legal.end());
+    REQUIRE(both == legal);
+
+    if (depth > 1) {
+        Savepos sp;
+        for (Move move : legal) {
+            position.make_move(sp, move);
+            check_capture_quiet_split(position, depth - 1);
+            position.undo_move(sp, move);
+        }
+    }
+}
+
+TEST_CASE("generate_captures and generate_quiets", "[position]")
+{
+    Zobrist::initialize();
+
+    const char* fens[] = {
+        // kiwipete
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        // lots of checks and en passant
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        // promotions, including blocking a check by promoting
+        "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    };
+    for (const char* fen : fens) {
+        auto position = Position::from_fen(fen);
+        check_capture_quiet_split(position, 3);
+    }
+}
+
+TEST_CASE("Static exchange evaluation", "[position]")
+{
+    SECTION("Undefended piece")
+    {
+        auto position = Position::from_fen("4k3/8/8/3n4/4P3/8/8/4K3 w - - 0 1");
+        REQUIRE(position.see(Move(E4, D5)) == 300);
+    }
+
+    SECTION("Queen takes a defended pawn")
+    {
+        auto position = Position::from_fen("4k3/8/2p5/3p4/8/8/8/3QK3 w - - 0 1");
+        REQUIRE(position.see(Move(D1, D5)) == 100 - 800);
+    }
+
+    SECTION("Equal trade")
+    {
+        auto position = Position::from_fen("4k3/8/2p5/3n4/8/4N3/8/4K3 w - - 0 1");
+        REQUIRE(position.see(Move(E3, D5)) == 0);
+    }
+
+    SECTION("Rooks doubled behind each other")
+    {
+        // the second rook x-rays through the first, so white wins the pawn
+        auto position = Position::from_fen("3rk3/8/8/3p4/8/8/3R4/3RK3 w - - 0 1");
+        REQUIRE(position.see(Move(D2, D5)) == 100);
+        // without the second rook the exchange loses the rook
+        auto single = Position::from_fen("3rk3/8/8/3p4/8/8/3R4/4K3 w - - 0 1");
+        REQUIRE(single.see(Move(D2, D5)) == 100 - 500);
+    }
+
+    SECTION("Bishop behind a pawn")
+    {
+        // exd5 Nxd5 and the bishop behind e4 takes back
+        auto position = Position::from_fen("4k3/8/1n6/3p4/4P3/5B2/8/4K3 w - - 0 1");
+        REQUIRE(position.see(Move(E4, D5)) == 100);
+        auto no_bishop = Position::from_fen("4k3/8/1n6/3p4/4P3/8/8/4K3 w - - 0 1");
+        REQUIRE(no_bishop.see(Move(E4, D5)) == 0);
+    }
+
+    SECTION("King can't recapture on a defended square")
+    {
+        auto position = Position::from_fen("4k3/8/8/8/3q4/2n5/8/3RK3 b - - 0 1");
+        REQUIRE(position.see(Move(D4, D1)) == 500);
+        auto undefended = Position::from_fen("4k3/8/8/8/3q4/8/8/3RK3 b - - 0 1");
+        REQUIRE(undefended.see(Move(D4, D1)) == 500 - 800);
+    }
+
+    SECTION("En passant")
+    {
+        auto position = Position::from_fen("4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1");
+        REQUIRE(position.see(Move::make_enpassant(E5, D6)) == 100);
+    }
+
+    SECTION("Promotion")
+    {
+        auto position = Position::from_fen("1r2k3/P7/8/8/8/8/8/4K3 w - - 0 1");
+        REQUIRE(position.see(Move::make_promotion(A7, B8, QUEEN)) == 500 + 800 - 100);
+        auto guarded = Position::from_fen("3rk3/P7/8/8/8/8/8/4K3 w - - 0 1");
+        REQUIRE(guarded.see(Move::make_promotion(A7, A8, QUEEN)) == -100);
+    }
+
+    SECTION("Castling")
+    {
+        auto position = Position::from_fen("4k3/8/8/8/8/8/8/4K2R w K - 0 1");
+        REQUIRE(position.see(Move::make_castle(Castle::WHITE_KING_SIDE)) == 0);
+    }
+}
+
+TEST_CASE("make_null_move and undo_null_move", "[position]")
+{
+    Zobrist::initialize();
+
+    auto position = Position::from_fen("rnbqkbnr/ppp1pppp/8/8/3pP3/5N2/PPPP1PPP/RNBQKB1R b KQkq e3 0 3");
+    const std::string fen = position.dump_fen();
+    const u64 hash = position.zobrist_hash();
+
     Savepos sp;
-    position.make_move(sp, position.move_from_long_algebraic("e2e4"));
-    REQUIRE(position.is_repetition() == false);
-    position.make_move(sp, position.move_from_long_algebraic("e7e5"));
-    REQUIRE(position.is_repetition() == false);
-
-    position.dump_hashes();
-    position.make_move(sp, position.move_from_long_algebraic("f1c4"));
-    REQUIRE(position.is_repetition() == false);
-    position.make_move(sp, position.move_from_long_algebraic("f8c5"));
-    REQUIRE(position.is_repetition() == false);
-
-    position.make_move(sp, position.move_from_long_algebraic("c4f1"));
-    REQUIRE(position.is_repetition() == true);
-    position.make_move(sp, position.move_from_long_algebraic("c5f8"));
-    REQUIRE(position.is_repetition() == true);
+    position.make_null_move(sp);
+    REQUIRE(position.color_to_move() == WHITE);
+    REQUIRE(position.enpassant_available() == false);
+    REQUIRE(position.zobrist_hash() != hash);
+    // same as if the position had been set up with white to move
+    auto passed = Position::from_fen("rnbqkbnr/ppp1pppp/8/8/3pP3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 0 3");
+    REQUIRE(position.zobrist_hash() == passed.zobrist_hash());
+
+    position.undo_null_move(sp);
+    REQUIRE(position.dump_fen() == fen);
+    REQUIRE(position.zobrist_hash() == hash);
+}
+
+TEST_CASE("is_valid_move agrees with is_legal_move", "[position]")
+{
+    const char* fens[] = {
+        start_position_fen.c_str(),
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "8/2p5/8/KP1p3r/1R3p1k/8/4P1P1/8 w - d6 0 1",
+        "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        // in check
+        "r3k2r/8/8/8/8/8/3q4/R3K2R w KQkq - 0 1",
+    };
+
+    // candidate moves: every from/to pair, plus everything legal in any of
+    // the positions, which covers promotions, castling and en passant
+    std::vector<Move> candidates;
+    for (int from = 0; from < 64; ++from) {
+        for (int to = 0; to < 64; ++to) {
+            if (from != to) {
+                candidates.push_back(Move(from, to));
+            }
+        }
+    }
+    for (const char* fen : fens) {
+        auto position = Position::from_fen(fen);
+        Move moves[MAX_MOVES];
+        int nmoves = position.generate_legal_moves(&moves[0]);
+        candidates.insert(candidates.end(), &moves[0], &moves[nmoves]);
+    }
+
+    for (const char* fen : fens) {
+        auto position = Position::from_fen(fen);
+        for (Move move : candidates) {
+            INFO(fen << " " << move.to_long_algebraic_string());
+            REQUIRE(position.is_valid_move(move) == position.is_legal_move(move));
+        }
+    }
 }
@@ -2,6 +2,8 @@
 #include "evaluate.h"
 #include <array>
 #include <cassert>
+#include <algorithm>
+#include <cmath>
 #include <functional>
 #include <vector> // TEMP TEMP
 #include <cstring>
@@ -20,9 +22,7 @@ namespace lesschess {
 // 128 is probably safe? 256 is definitely safe since willing to bet the the 7 Qs
 // position isn't going to happen -- will either be checkmate or stalemate.
 
-// TODO: what is the maximum number of possible moves in a position?
-// using Moves = std::vector<Move>; // TODO: change this back to std::array<Move, 256>?
-using Moves = std::array<Move, 128>;
+using Moves = std::array<Move, MAX_MOVES>;
 
 template <int N>
 void PrimaryVariation<N>::dump() const
@@ -46,38 +46,214 @@ void copy_line(Line& dst, Line& src, Move move, int score) noexcept
     dst.count = src.count + 1;
 }
 
+bool HashHistory::is_repetition(u64 hash, int halfmoves) const noexcept
+{
+    // only every other position has the same side to move
+    const int game_size = _game ? static_cast<int>(_game->size()) : 0;
+    for (int back = 2; back <= halfmoves; back += 2) {
+        const int i = _count - back;
+        if (i >= 0) {
+            if (_search[i] == hash) {
+                return true;
+            }
+        } else if (game_size + i >= 0) {
+            if ((*_game)[game_size + i] == hash) {
+                return true;
+            }
+        } else {
+            break;
+        }
+    }
+    return false;
+}
+
+// the clock is only read every this many nodes
+constexpr s64 CHECK_TIME_NODES = 1024;
+
+// null-move pruning is only tried this far from the horizon, and the null
+// move is searched NULL_MOVE_REDUCTION (+1 when deeper) plies shallower
+constexpr int NULL_MOVE_MIN_DEPTH = 4;
+constexpr int NULL_MOVE_REDUCTION = 2;
+
+// reverse futility pruning: at depth <= RFP_MAX_DEPTH a node whose static eval
+// beats beta by RFP_MARGIN per ply fails high without searching. Kept shallow
+// since a side far ahead in material may still be mated in a couple of moves.
+constexpr int RFP_MAX_DEPTH = 2;
+constexpr int RFP_MARGIN = 100;
+
+// razoring: at depth <= RAZOR_MAX_DEPTH a node whose static eval is
+// RAZOR_MARGIN[depth] below alpha only gets a quiescence search. Only at the
+// frontier, deeper than that it misses quiet mating moves.
+constexpr int RAZOR_MAX_DEPTH = 1;
+constexpr int RAZOR_MARGIN[RAZOR_MAX_DEPTH + 1] = { 0, 300 };
+
+// futility pruning: at depth <= FUTILITY_MAX_DEPTH quiet moves aren't searched
+// when the static eval plus FUTILITY_MARGIN[depth] can't reach alpha
+constexpr int FUTILITY_MAX_DEPTH = 3;
+constexpr int FUTILITY_MARGIN[FUTILITY_MAX_DEPTH + 1] = { 0, 200, 350, 500 };
+
+// internal iterative deepening: a node without a TT move first gets a
+// shallower search to find one. At PV nodes IID_PV_MIN_DEPTH or more from the
+// horizon it's IID_REDUCTION plies shallower. Elsewhere a bad first move costs
+// less, so only from IID_MIN_DEPTH and to half the depth.
+constexpr int IID_PV_MIN_DEPTH = 5;
+constexpr int IID_MIN_DEPTH = 7;
+constexpr int IID_REDUCTION = 2;
+
+// singular extensions: from SINGULAR_MIN_DEPTH, a TT move whose lower bound
+// is from at most SINGULAR_TT_DEPTH plies shallower is searched one ply
+// deeper when every other move fails low against it, minus SINGULAR_MARGIN
+// per ply, at half the depth
+constexpr int SINGULAR_MIN_DEPTH = 8;
+constexpr int SINGULAR_TT_DEPTH = 3;
+constexpr int SINGULAR_MARGIN = 2;
+
+// late move pruning: at depth <= LMP_MAX_DEPTH, quiet moves after the first
+// LMP_MOVES[depth] aren't searched at all
+constexpr int LMP_MAX_DEPTH = 3;
+constexpr int LMP_MOVES[LMP_MAX_DEPTH + 1] = { 0, 5, 8, 13 };
+
+// late move reductions are only applied this far from the horizon, and not
+// to the first LMR_MIN_MOVES moves
+constexpr int LMR_MIN_DEPTH = 3;
+constexpr int LMR_MIN_MOVES = 3;
+
+// [depth][move number] late move reduction, in plies
+std::array<std::array<int, MAX_MOVES>, MAX_DEPTH> reductions;
+
+void init_reductions(int base, int divisor) noexcept
+{
+    for (int depth = 1; depth < MAX_DEPTH; ++depth) {
+        for (int moveno = 1; moveno < MAX_MOVES; ++moveno) {
+            const double r = base / 100.0 + std::log(depth) * std::log(moveno) / (divisor / 100.0);
+            reductions[depth][moveno] = static_cast<int>(r);
+        }
+    }
+}
+
+// built with the default parameters at startup, the UCI options rebuild it
+const bool reductions_initialized = (init_reductions(LMR_BASE, LMR_DIVISOR), true);
+
+// The clock doesn't run while pondering. On the first check after
+// "ponderhit" it starts, so the search gets all of its time on top of what
+// it already spent pondering.
+bool pondering(SearchContext& ctx) noexcept
+{
+    if (ctx.pondering && !(ctx.ponder && ctx.ponder->load(std::memory_order_relaxed))) {
+        ctx.pondering = false;
+        ctx.time.restart();
+    }
+    return ctx.pondering;
+}
+
+// enforce the node and time limits, called at every node. The other threads'
+// node counters are only summed every CHECK_TIME_NODES nodes; searching alone
+// this thread's own count is the total, so the limit is still exact.
+void check_limits(SearchContext& ctx) noexcept
+{
+    const s64 nodes = ctx.metrics.nodes + ctx.metrics.qnodes;
+    ctx.nodes.store(nodes, std::memory_order_relaxed);
+    if (ctx.limits.nodes > 0 && nodes >= ctx.limits.nodes) {
+        ctx.halt();
+    } else if ((nodes % CHECK_TIME_NODES) == 0) {
+        if (ctx.limits.nodes > 0 && ctx.total_nodes() >= ctx.limits.nodes) {
+            ctx.halt();
+        } else if (!pondering(ctx) && ctx.time.hard_limit_reached()) {
+            ctx.halt();
+        }
+    }
+}
+
+bool is_mate_score(int score) noexcept
+{
+    return score >= MATE_BOUND || score <= -MATE_BOUND;
+}
+
+int mate_distance(int score) noexcept
+{
+    assert(is_mate_score(score));
+    return score > 0 ? (CHECKMATE - score + 1) / 2 : -(CHECKMATE + score) / 2;
+}
+
+// mate scores are relative to the root, but a TT entry can be reached at a
+// different ply, so they're stored relative to the node instead
+int value_to_tt(int value, int ply) noexcept
+{
+    if (value >= MATE_BOUND) {
+        return value + ply;
+    } else if (value <= -MATE_BOUND) {
+        return value - ply;
+    }
+    return value;
+}
+
+int value_from_tt(int value, int ply) noexcept
+{
+    if (value >= MATE_BOUND) {
+        return value - ply;
+    } else if (value <= -MATE_BOUND) {
+        return value + ply;
+    }
+    return value;
+}
+
 // alpha = lower bound on maximizer's score
 // beta  = upper bound on minimizer's score
 
-int quiescence(Position& position, int alpha, int beta, SearchMetrics& metrics, Line& pline)
+// PV nodes are searched with an open window and keep track of the principal
+// variation. Everything else is searched with a null window (beta ==
+// alpha + 1) only to learn whether it fails high or low, so there is no line
+// to keep.
+enum NodeType { PV_NODE, NON_PV_NODE };
+
+template <NodeType Node>
+int quiescence(Position& position, int alpha, int beta, SearchContext& ctx, Line& pline)
 {
+    constexpr bool pv_node = Node == PV_NODE;
+    SearchMetrics& metrics = ctx.metrics;
     assert(beta >= alpha);
     metrics.qnodes++;
+    pline.count = 0;
 
-    // if (is_repetition(metrics.pv, position.fifty_move_rule_moves())) {
-    //     return DRAW;
-    // }
+    check_limits(ctx);
+    if (ctx.stopped()) {
+        return 0;
+    }
 
+    const int ply = metrics.pv.count;
+    const bool in_check = position.in_check(position.color_to_move());
     int score = side_relative_score(position, evaluate(position));
-    if (score >= beta) { // failed hard beta-cutoff
-        metrics.beta_cutoffs++;
-        pline.count = 0;
-        return beta;
+    if (ply >= MAX_DEPTH - 1) {
+        return score;
     }
-    if (score > alpha) {
-        alpha = score;
+
+    // in check standing pat isn't an option, every evasion is searched
+    // instead of just the captures
+    if (!in_check) {
+        if (score >= beta) { // failed hard beta-cutoff
+            metrics.beta_cutoffs++;
+            return beta;
+        }
+        if (score > alpha) {
+            alpha = score;
+        }
     }
 
     Line line;
     Savepos sp;
-    Moves moves; // TODO: tune this number, likely can be lower
-    int nmoves = position.generate_captures(&moves[0]);
-    for (int i = 0; i < nmoves; ++i) {
-        position.make_move(sp, moves[i]);
-        metrics.pv.push(moves[i]);
-        score = -quiescence(position, -beta, -alpha, metrics, line);
+    MovePicker picker = in_check ? MovePicker(position, MOVE_NONE, Killers{}, MOVE_NONE, ctx.history)
+                                 : MovePicker(position);
+    int nmoves = 0;
+    for (Move move; (move = picker.next()) != MOVE_NONE; ) {
+        ++nmoves;
+        position.make_move(sp, move);
+        metrics.pv.push(move);
+        score = -quiescence<Node>(position, -beta, -alpha, ctx, line);
         metrics.pv.pop();
-        position.undo_move(sp, moves[i]);
+        position.undo_move(sp, move);
+        if (ctx.stopped()) {
+            return 0;
+        }
         if (score >= beta) { // failed hard beta-cutoff
             ++metrics.beta_cutoffs;
             return beta;
@@ -85,9 +261,14 @@ int quiescence(Position& position, int alpha, int beta, SearchMetrics& metrics,
         if (score > alpha) {
             ++metrics.alpha_cutoffs;
             alpha = score;
-            copy_line(pline, line, moves[i], score);
+            if (pv_node) {
+                copy_line(pline, line, move, score);
+            }
         }
     }
+    if (in_check && nmoves == 0) {
+        return mated_in(ply);
+    }
 
     return alpha;
 }
@@ -100,6 +281,19 @@ std::ostream& operator<<(std::ostream& os, const SearchMetrics& metrics)
         << "Nodes Searched  : " << metrics.nodes << "\n"
         << "Leaf Nodes      : " << metrics.lnodes << "\n"
         << "Quiescence Nodes: " << metrics.qnodes << "\n"
+        << "TT Hits         : " << metrics.tt_hits << "\n"
+        << "PVS Re-searches : " << metrics.researches << "\n"
+        << "Null Cutoffs    : " << metrics.null_cutoffs << "\n"
+        << "LMR Re-searches : " << metrics.lmr_researches << "\n"
+        << "LMP Pruned      : " << metrics.lmp_pruned << "\n"
+        << "Check Extensions: " << metrics.check_extensions << "\n"
+        << "RFP Cutoffs     : " << metrics.rfp_cutoffs << "\n"
+        << "Razored         : " << metrics.razored << "\n"
+        << "Futility Pruned : " << metrics.futility_pruned << "\n"
+        << "IID Searches    : " << metrics.iid_searches << "\n"
+        << "Singular Exts   : " << metrics.singular_extensions << "\n"
+        << "First Move Cuts : " << metrics.first_move_cutoffs << "/" << metrics.move_cutoffs
+        << " (" << (metrics.move_cutoffs ? 100 * metrics.first_move_cutoffs / metrics.move_cutoffs : 0) << "%)\n"
         << "=========================\n";
     return os;
 }
@@ -125,134 +319,549 @@ void sort_moves(const Position& position, MoveIter first, MoveIter last) noexcep
     );
 }
 
-int negamax(Position& position, int alpha, int beta, int depth, TT* tt,
-        SearchMetrics& metrics, Line& pline)
+template <NodeType Node>
+int negamax(Position& position, int alpha, int beta, int depth, SearchContext& ctx, Line& pline)
 {
+    constexpr bool pv_node = Node == PV_NODE;
+    TT* tt = ctx.tt;
+    SearchMetrics& metrics = ctx.metrics;
     metrics.nodes++;
     assert(beta >= alpha);
+    assert(pv_node || beta == alpha + 1);
+    pline.count = 0;
+
+    check_limits(ctx);
+    if (ctx.stopped()) {
+        return 0;
+    }
+
+    // a repetition anywhere along the path counts as a draw, if it was worth
+    // repeating once it will be worth repeating again
+    if (ctx.hashes.is_repetition(position.zobrist_hash(), position.fifty_move_rule_moves())) {
+        return DRAW;
+    }
+
+    // mate distance pruning: even mate on the next move can't beat a
+    // shorter mate already found, and being mated here can't be worse than
+    // one found closer to the root
+    const int ply = metrics.pv.count;
+    alpha = std::max(alpha, mated_in(ply));
+    beta = std::min(beta, mate_in(ply + 1));
+    if (alpha >= beta) {
+        return alpha;
+    }
+
+    // check extension: a position in check is searched one ply deeper, so
+    // the checks at the horizon are always resolved by the main search. The
+    // depth indexes tables sized MAX_DEPTH, so it's never extended past that.
+    const Color side = position.color_to_move();
+    const bool in_check = position.in_check(side);
+    if (in_check) {
+        depth = std::min(depth + 1, MAX_DEPTH - 1);
+        metrics.check_extensions++;
+    }
+    assert(depth < MAX_DEPTH);
+
+    // the singular extension search of this node leaves out one move, and
+    // has its own TT entry
+    const Move excluded = ctx.excluded[ply];
+    const u64 tt_key = excluded == MOVE_NONE ? position.zobrist_hash()
+                                             : TT::excluded_key(position.zobrist_hash(), excluded);
 
-    Moves moves;
     Savepos sp;
     int value, score;
     int alpha_orig = alpha;
-    auto* tt_entry = tt ? &tt->find(position.zobrist_hash()) : nullptr;
-    if (tt_entry && tt_entry->is_valid() && tt_entry->depth >= depth) {
-        tt->record_hit();
-
-        if (tt_entry->is_exact()) {
-            return tt_entry->value;
-        } else if (tt_entry->is_lower()) {
-            alpha = std::max(alpha, tt_entry->value);
-        } else if (tt_entry->is_upper()) {
-            beta = std::min(beta, tt_entry->value);
+    Move best_move = MOVE_NONE;
+    TT::Entry tt_entry;
+    bool tt_hit = tt && tt->probe(tt_key, tt_entry);
+    if (tt_hit && tt_entry.depth >= depth) {
+        metrics.tt_hits++;
+
+        const int tt_value = value_from_tt(tt_entry.value, ply);
+        if (tt_entry.is_exact()) {
+            return tt_value;
+        } else if (tt_entry.is_lower()) {
+            alpha = std::max(alpha, tt_value);
+        } else if (tt_entry.is_upper()) {
+            beta = std::min(beta, tt_value);
         } else {
             assert(0 && "invalid tt entry");
         }
 
         if (alpha >= beta) {
             metrics.beta_cutoffs++;
-            return tt_entry->value;
+            return tt_value;
         }
     }
 
-    if (depth == 0) {
-        value = quiescence(position, alpha, beta, metrics, pline);
+    if (depth == 0 || metrics.pv.count >= MAX_DEPTH - 1) {
+        value = quiescence<Node>(position, alpha, beta, ctx, pline);
         // value = side_relative_score(position, evaluate(position));
         metrics.lnodes++;
     } else if (position.fifty_move_rule_moves() >= 50) {
-        // TODO: check for 3-move repetition
         value = FIFTY_MOVE_RULE_DRAW;
     } else {
-        int nmoves = position.generate_legal_moves(&moves[0]);
-        if (nmoves == 0) {
-            // TODO: cache `checkers` from generate_legal_moves() so we can check if mate or stalemate?
-            value = position.in_check(position.color_to_move()) ? -CHECKMATE : STALEMATE;
-        } else {
-            Line line;
-            sort_moves(position, &moves[0], &moves[nmoves]);
-            value = -MAX_SCORE;
-            for (int i = 0; i < nmoves; ++i) {
-                position.make_move(sp, moves[i]);
-                metrics.pv.push(moves[i]);
-                score = -negamax(position, -beta, -alpha, depth - 1, tt, metrics, line);
-                metrics.pv.pop();
-                position.undo_move(sp, moves[i]);
-                value = std::max(value, score);
-                if (value >= beta) {
-                    metrics.beta_cutoffs++;
-                    break;
+        Line line;
+
+        // the static eval is only needed away from the PV, and means nothing
+        // in check
+        const int eval = pv_node || in_check ? -MAX_SCORE : side_relative_score(position, evaluate(position));
+
+        // reverse futility pruning: so far above beta that no move is going
+        // to bring it back down within a few plies
+        if (!pv_node && !in_check && excluded == MOVE_NONE && depth <= RFP_MAX_DEPTH && !is_mate_score(beta) &&
+                eval - RFP_MARGIN * depth >= beta) {
+            metrics.rfp_cutoffs++;
+            return eval;
+        }
+
+        // razoring: so far below alpha that only captures could help, so
+        // the quiescence search answers for the whole node
+        if (!pv_node && !in_check && excluded == MOVE_NONE && depth <= RAZOR_MAX_DEPTH &&
+                eval + RAZOR_MARGIN[depth] < alpha) {
+            metrics.razored++;
+            return quiescence<NON_PV_NODE>(position, alpha, alpha + 1, ctx, line);
+        }
+
+        // null-move pruning: if passing still fails high, a real move almost
+        // certainly would too. Not done twice in a row, in check, or without
+        // pieces, where passing can be better than any move (zugzwang).
+        if (!pv_node && depth >= NULL_MOVE_MIN_DEPTH && ply > 0 && metrics.pv.back() != MOVE_NONE &&
+                position.has_non_pawn_material(side) && !in_check && excluded == MOVE_NONE && eval >= beta) {
+            const int R = NULL_MOVE_REDUCTION + (depth >= 7 ? 1 : 0);
+            ctx.hashes.push(position.zobrist_hash());
+            position.make_null_move(sp);
+            metrics.pv.push(MOVE_NONE);
+            score = -negamax<NON_PV_NODE>(position, -beta, -beta + 1, std::max(depth - 1 - R, 0), ctx, line);
+            metrics.pv.pop();
+            position.undo_null_move(sp);
+            ctx.hashes.pop();
+            if (ctx.stopped()) {
+                return 0;
+            }
+            if (score >= beta) {
+                metrics.null_cutoffs++;
+                // don't trust a mate found after passing
+                return is_mate_score(score) ? beta : score;
+            }
+        }
+
+        // internal iterative deepening: without a TT move the ordering is
+        // only a guess, a shallower search of this node leaves a good first
+        // move in the TT
+        Move tt_move = tt_hit ? tt_entry.move : MOVE_NONE;
+        if (tt_move == MOVE_NONE && excluded == MOVE_NONE &&
+                depth >= (pv_node ? IID_PV_MIN_DEPTH : IID_MIN_DEPTH)) {
+            const int iid_depth = pv_node ? depth - IID_REDUCTION : depth / 2;
+            negamax<Node>(position, alpha, beta, iid_depth, ctx, line);
+            if (ctx.stopped()) {
+                return 0;
+            }
+            metrics.iid_searches++;
+            if (tt && tt->probe(tt_key, tt_entry)) {
+                tt_move = tt_entry.move;
+            } else if (line.count > 0) {
+                tt_move = line.moves[0];
+            }
+        }
+
+        // singular extension: when the TT move is at least a lower bound and
+        // every other move falls well short of it in a shallower search, it
+        // is the only move here and is searched a ply deeper. Only up to
+        // twice the iteration depth from the root, so chains of extensions
+        // can't keep the search going forever.
+        bool singular = false;
+        if (tt_hit && tt_move != MOVE_NONE && excluded == MOVE_NONE && depth >= SINGULAR_MIN_DEPTH &&
+                ply < 2 * ctx.root_depth &&
+                !tt_entry.is_upper() && tt_entry.depth >= depth - SINGULAR_TT_DEPTH &&
+                !is_mate_score(value_from_tt(tt_entry.value, ply))) {
+            const int singular_beta = value_from_tt(tt_entry.value, ply) - SINGULAR_MARGIN * depth;
+            ctx.excluded[ply] = tt_move;
+            score = negamax<NON_PV_NODE>(position, singular_beta - 1, singular_beta, (depth - 1) / 2, ctx, line);
+            ctx.excluded[ply] = MOVE_NONE;
+            if (ctx.stopped()) {
+                return 0;
+            }
+            if (score < singular_beta) {
+                singular = true;
+                metrics.singular_extensions++;
+            }
+        }
+
+        const Move previous = ply > 0 ? metrics.pv.back() : MOVE_NONE;
+        MovePicker picker(position, tt_move, ctx.killers[ply],
+                ctx.counters.get(previous), ctx.history);
+        // quiet moves searched so far, penalized in the history if a later
+        // move causes the cutoff
+        Move quiets[MAX_MOVES];
+        int nquiets = 0;
+        int nmoves = 0;
+        value = -MAX_SCORE;
+        for (Move move; (move = picker.next()) != MOVE_NONE; ) {
+            if (move == excluded) {
+                continue;
+            }
+            ++nmoves;
+            const int new_depth = std::min(depth - 1 + (singular && move == tt_move ? 1 : 0), MAX_DEPTH - 1);
+            const bool quiet = !position.is_capture(move) && !move.is_promotion();
+            const u64 hash = position.zobrist_hash();
+            position.make_move(sp, move);
+            const bool gives_check = position.in_check(position.color_to_move());
+
+            // late move pruning: quiet moves this far down the list at the
+            // edge of the tree are very unlikely to matter. Checks are kept
+            // since they may be mate, and so is looking for a way out once
+            // every move so far has been mated.
+            if (!pv_node && quiet && !in_check && !gives_check && depth <= LMP_MAX_DEPTH &&
+                    nmoves > LMP_MOVES[depth] && value > -MATE_BOUND) {
+                position.undo_move(sp, move);
+                metrics.lmp_pruned++;
+                continue;
+            }
+
+            // futility pruning: a quiet move won't make up the difference
+            // between the static eval and alpha at the frontier
+            if (!pv_node && quiet && !in_check && !gives_check && depth <= FUTILITY_MAX_DEPTH &&
+                    nmoves > 1 && value > -MATE_BOUND && eval + FUTILITY_MARGIN[depth] <= alpha) {
+                position.undo_move(sp, move);
+                metrics.futility_pruned++;
+                continue;
+            }
+
+            metrics.pv.push(move);
+            ctx.hashes.push(hash);
+            // principal variation search: assume the first move is the best
+            // and only prove that the others are worse with a null window,
+            // searching again with the full window when that fails
+            if (nmoves == 1) {
+                score = -negamax<Node>(position, -beta, -alpha, new_depth, ctx, line);
+            } else {
+                // late move reductions: quiet moves late in the ordering get
+                // a shallower null window search first, and the full depth
+                // only if that beats alpha
+                int r = 0;
+                if (quiet && !in_check && !gives_check && depth >= LMR_MIN_DEPTH && nmoves > LMR_MIN_MOVES) {
+                    r = reductions[depth][nmoves];
+                    if (pv_node || ctx.killers[ply].contains(move)) {
+                        --r;
+                    }
+                    r = std::clamp(r, 0, depth - 2);
+                }
+                score = -negamax<NON_PV_NODE>(position, -alpha - 1, -alpha, new_depth - r, ctx, line);
+                if (r > 0 && score > alpha) {
+                    metrics.lmr_researches++;
+                    score = -negamax<NON_PV_NODE>(position, -alpha - 1, -alpha, new_depth, ctx, line);
+                }
+                if (pv_node && score > alpha && score < beta) {
+                    metrics.researches++;
+                    score = -negamax<PV_NODE>(position, -beta, -alpha, new_depth, ctx, line);
+                }
+            }
+            ctx.hashes.pop();
+            metrics.pv.pop();
+            position.undo_move(sp, move);
+            if (ctx.stopped()) {
+                return 0;
+            }
+            if (score > value) {
+                value = score;
+                best_move = move;
+            }
+            if (value >= beta) {
+                metrics.beta_cutoffs++;
+                metrics.move_cutoffs++;
+                if (nmoves == 1) {
+                    metrics.first_move_cutoffs++;
                 }
-                if (value > alpha) {
-                    metrics.alpha_cutoffs++;
-                    alpha = value;
-                    copy_line(pline, line, moves[i], value);
+                if (quiet) {
+                    const int bonus = History::bonus(depth);
+                    ctx.killers[ply].update(move);
+                    ctx.counters.update(previous, move);
+                    ctx.history.update(side, move, bonus);
+                    for (int i = 0; i < nquiets; ++i) {
+                        ctx.history.update(side, quiets[i], -bonus);
+                    }
                 }
+                break;
+            }
+            if (value > alpha) {
+                metrics.alpha_cutoffs++;
+                alpha = value;
+                if (pv_node) {
+                    copy_line(pline, line, move, value);
+                }
+            }
+            if (quiet) {
+                quiets[nquiets++] = move;
+            }
+        }
+        if (nmoves == 0) {
+            // with the only move excluded, everything else failed low
+            if (excluded != MOVE_NONE) {
+                value = alpha;
+            } else {
+                value = in_check ? mated_in(ply) : STALEMATE;
             }
         }
     }
 
-    if (tt_entry) {
-        tt_entry->value = value;
+    // a stopped search's value means nothing, and must not be stored
+    if (ctx.stopped()) {
+        return 0;
+    }
+
+    if (tt) {
+        TT::Flag flag;
         if (value <= alpha_orig) {
-            tt_entry->flag = TT::Flag::kUpper;
+            flag = TT::Flag::kUpper;
         } else if (value >= beta) {
-            tt_entry->flag = TT::Flag::kLower;
+            flag = TT::Flag::kLower;
         } else {
-            tt_entry->flag = TT::Flag::kExact;
+            flag = TT::Flag::kExact;
         }
-        tt_entry->depth = depth;
+        tt->store(tt_key, flag, depth, value_to_tt(value, ply), best_move);
     }
 
     return value;
 }
 
-SearchResult search(Position& position, TT* tt, int depth, SearchMetrics& metrics, Line& bestline)
+int search_root(Position& position, Move* moves, int nmoves, int alpha, int beta, int depth,
+        SearchContext& ctx, Line& bestline)
 {
+    SearchMetrics& metrics = ctx.metrics;
     Savepos sp;
-    Moves moves;
-    int nmoves = position.generate_legal_moves(&moves[0]);
-    sort_moves(position, &moves[0], &moves[nmoves]);
-    memset(&bestline, 0, sizeof(bestline));
-    int bestmove = -1;
+    Line line;
     int bestscore = -MAX_SCORE;
-    int alpha = -MAX_SCORE; // -10;
-    int beta  =  MAX_SCORE; // 10;
+    int bestmove = -1;
     for (int i = 0; i < nmoves; ++i) {
-        Line line;
+        ctx.hashes.push(position.zobrist_hash());
         position.make_move(sp, moves[i]);
         metrics.pv.push(moves[i]);
-        int score = -negamax(position, alpha, beta, depth - 1, tt, metrics, line);
+        int score;
+        if (i == 0) {
+            score = -negamax<PV_NODE>(position, -beta, -alpha, depth - 1, ctx, line);
+        } else {
+            score = -negamax<NON_PV_NODE>(position, -alpha - 1, -alpha, depth - 1, ctx, line);
+            if (score > alpha && score < beta) {
+                metrics.researches++;
+                score = -negamax<PV_NODE>(position, -beta, -alpha, depth - 1, ctx, line);
+            }
+        }
         metrics.pv.pop();
         position.undo_move(sp, moves[i]);
+        ctx.hashes.pop();
+        if (ctx.stopped()) {
+            break;
+        }
         if (score > bestscore) {
             bestscore = score;
+        }
+        if (score > alpha) {
+            alpha = score;
             bestmove = i;
             copy_line(bestline, line, moves[i], score);
+            if (score >= beta) {
+                break;
+            }
         }
     }
 
-    assert(bestmove != -1);
-    bestscore = position.white_to_move() ? bestscore : -bestscore;
+    // the next iteration (or re-search) starts with the best move found, unless
+    // every move failed low in which case none of them are trustworthy
+    if (bestmove != -1) {
+        std::rotate(&moves[0], &moves[bestmove], &moves[bestmove + 1]);
+    }
+    return bestscore;
+}
+
+// Search the root moves with a window around `prev_score`, the score from the
+// previous iteration, widening it on the side the score falls outside of
+// until it's inside.
+int aspiration_search(Position& position, Move* moves, int nmoves, int prev_score, int depth,
+        SearchContext& ctx, Line& line)
+{
+    s64 delta = ASPIRATION_WINDOW;
+    s64 alpha = -MAX_SCORE;
+    s64 beta  =  MAX_SCORE;
+    if (depth > 1 && !is_mate_score(prev_score)) {
+        alpha = std::max<s64>(prev_score - delta, -MAX_SCORE);
+        beta  = std::min<s64>(prev_score + delta,  MAX_SCORE);
+    }
+
+    int score;
+    for (;;) {
+        score = search_root(position, moves, nmoves, alpha, beta, depth, ctx, line);
+        if (ctx.stopped()) {
+            break;
+        }
+        if (score <= alpha && alpha > -MAX_SCORE) {
+            alpha = std::max<s64>(score - delta, -MAX_SCORE);
+        } else if (score >= beta && beta < MAX_SCORE) {
+            beta = std::min<s64>(score + delta, MAX_SCORE);
+        } else {
+            break;
+        }
+        delta *= 2;
+        if (is_mate_score(score)) {
+            alpha = -MAX_SCORE;
+            beta  =  MAX_SCORE;
+        }
+    }
+    return score;
+}
 
-    // // TEMP TEMP
-    // std::cout << "\nEnd of search:\nMove : " << moves[bestmove].to_long_algebraic_string() << "\n"
-    //     << "Score: " << bestscore << "\n"
-    //     << "Principal Variation: ";
-    // for (int i = 0; i < bestline.count; ++i) {
-    //     std::cout << bestline.moves[i].to_long_algebraic_string() << " ";
-    // }
-    // std::cout << "\nbestline.score = " << bestline.score << "\n\n";
+// Lazy SMP: helper threads skip some iterations so that they aren't all
+// searching the same depth as the main thread. Helper i skips SKIP_SIZE[i]
+// depths out of every 2*SKIP_SIZE[i], starting at SKIP_PHASE[i].
+constexpr int SKIP_TABLE_SIZE = 20;
+constexpr int SKIP_SIZE[SKIP_TABLE_SIZE]  = { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+constexpr int SKIP_PHASE[SKIP_TABLE_SIZE] = { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7 };
 
-    return {moves[bestmove], bestscore};
+bool skip_iteration(const SearchContext& ctx, int depth) noexcept
+{
+    if (ctx.thread_id == 0) {
+        return false;
+    }
+    const int i = (ctx.thread_id - 1) % SKIP_TABLE_SIZE;
+    return ((depth + SKIP_PHASE[i]) / SKIP_SIZE[i]) % 2 != 0;
+}
+
+
+SearchResult search(Position& position, SearchContext& ctx, const SearchLimits& limits, Line& bestline)
+{
+    Moves moves;
+    ctx.limits = limits;
+    ctx.time.init(limits, position.color_to_move());
+    ctx.metrics = SearchMetrics{};
+    ctx.history.age();
+    for (auto& killers : ctx.killers) {
+        killers.clear();
+    }
+    ctx.excluded.fill(MOVE_NONE);
+    ctx.halted = false;
+    ctx.pondering = limits.ponder;
+    ctx.nodes.store(0, std::memory_order_relaxed);
+    memset(&bestline, 0, sizeof(bestline));
+    int nmoves = position.generate_legal_moves(&moves[0]);
+
+    // checkmate or stalemate, there's nothing to search
+    if (nmoves == 0) {
+        const int score = position.in_check(position.color_to_move()) ? mated_in(0) : STALEMATE;
+        return {MOVE_NONE, position.white_to_move() ? score : -score};
+    }
+
+    // "go searchmoves": the other root moves are never searched, unless none
+    // of the given moves are legal here
+    if (!limits.searchmoves.empty()) {
+        const auto& searchmoves = limits.searchmoves;
+        Move* last = std::remove_if(&moves[0], &moves[nmoves], [&](Move move) {
+            return std::find(searchmoves.begin(), searchmoves.end(), move) == searchmoves.end();
+        });
+        if (last != &moves[0]) {
+            nmoves = static_cast<int>(last - &moves[0]);
+        }
+    }
+    sort_moves(position, &moves[0], &moves[nmoves]);
+    Move bestmove = moves[0];
+    int bestscore = -MAX_SCORE;
+    // MultiPV: root moves [0, multipv) are ranked, with the line and score
+    // of each from the last iteration
+    const int multipv = std::clamp(limits.multipv, 1, nmoves);
+    std::vector<Line> lines(multipv);
+    std::vector<int> scores(multipv, -MAX_SCORE);
+    int depth = MAX_DEPTH - 1;
+    if (limits.depth > 0) {
+        depth = std::min(depth, limits.depth);
+    }
+    if (limits.mate > 0) {
+        depth = std::min(depth, 2 * limits.mate);
+    }
+    s64 prev_iteration_msecs = 0;
+
+    // iterative deepening: each iteration seeds the next one's move ordering
+    // through the root move order and the TT, and narrows the root window
+    // around the previous score
+    for (int d = 1; d <= depth; ++d) {
+        if (skip_iteration(ctx, d) && d < depth) {
+            continue;
+        }
+        const s64 iteration_start = ctx.time.elapsed();
+        ctx.root_depth = d;
+
+        // each MultiPV slot is the best of the root moves not already taken
+        // by the slots above it, search_root() leaves it at the front of the
+        // moves it was given
+        for (int slot = 0; slot < multipv; ++slot) {
+            scores[slot] = aspiration_search(position, &moves[slot], nmoves - slot, scores[slot], d, ctx,
+                    lines[slot]);
+            if (ctx.stopped()) {
+                break;
+            }
+        }
+
+        // an interrupted iteration is thrown away, the result is always from
+        // the last completed iteration
+        if (ctx.stopped()) {
+            break;
+        }
+
+        // a slot can come out ahead of the one above it, when that one's
+        // score dropped at this depth
+        for (int i = 1; i < multipv; ++i) {
+            for (int j = i; j > 0 && scores[j] > scores[j - 1]; --j) {
+                std::swap(moves[j], moves[j - 1]);
+                std::swap(scores[j], scores[j - 1]);
+                std::swap(lines[j], lines[j - 1]);
+            }
+        }
+
+        bestscore = scores[0];
+        bestmove = moves[0];
+        bestline = lines[0];
+        if (ctx.info) {
+            for (int slot = 0; slot < multipv; ++slot) {
+                ctx.info(d, slot + 1, scores[slot], lines[slot], ctx.metrics, ctx.total_nodes());
+            }
+        }
+
+        if (limits.mate > 0 && bestscore >= mate_in(2 * limits.mate - 1)) {
+            break;
+        }
+        const s64 iteration_msecs = ctx.time.elapsed() - iteration_start;
+        if (!pondering(ctx) && !ctx.time.start_next_iteration(prev_iteration_msecs, iteration_msecs)) {
+            break;
+        }
+        prev_iteration_msecs = iteration_msecs;
+    }
+
+    bestscore = position.white_to_move() ? bestscore : -bestscore;
+    return {bestmove, bestscore};
 }
 
 SearchResult easy_search(Position& position, bool useTT)
 {
-    SearchMetrics metrics;
+    SearchContext ctx;
+    Line bestline;
+    TT table{TT::MinSizeMB};
+    ctx.tt = useTT ? &table : nullptr;
+    ctx.hashes.reset(nullptr);
+    table.new_search();
+    SearchLimits limits;
+    limits.depth = 4;
+    return search(position, ctx, limits, bestline);
+}
+
+SearchResult easy_search(Position& position, const SearchLimits& limits, const std::vector<u64>* game,
+        InfoCallback info)
+{
+    SearchContext ctx;
     Line bestline;
-    TT table;
-    TT* tt = useTT ? &table : nullptr;
-    return search(position, tt, /*max_depth*/4, metrics, bestline);
+    TT table{TT::MinSizeMB};
+    ctx.tt = &table;
+    ctx.hashes.reset(game);
+    ctx.info = std::move(info);
+    table.new_search();
+    return search(position, ctx, limits, bestline);
 }
 
 } // ~namespace lesschess
@@ -1,9 +1,13 @@
 #pragma once
 
+#include "movepick.h"
 #include "position.h"
+#include "timeman.h"
 #include "tt.h"
+#include <atomic>
 #include <climits>
 #include <array>
+#include <functional>
 #include <iostream>
 #include <vector>
 #include <array>
@@ -19,6 +23,14 @@ constexpr int FIFTY_MOVE_RULE_DRAW = DRAW;
 constexpr int WHITE_CHECKMATE = CHECKMATE;
 constexpr int BLACK_CHECKMATE = -CHECKMATE;
 constexpr int MAX_DEPTH = 128; // 32;
+// Mate scores count down from CHECKMATE by the number of plies from the root
+// to the mate, so shorter mates score higher. Anything past MATE_BOUND is a
+// mate score.
+constexpr int MATE_BOUND = CHECKMATE - MAX_DEPTH;
+constexpr int ASPIRATION_WINDOW = 50; // initial half-width of the root window, in centipawns
+// default late move reduction parameters, in hundredths of a ply, see init_reductions()
+constexpr int LMR_BASE = 75;
+constexpr int LMR_DIVISOR = 225;
 
 template <int N>
 struct PrimaryVariation {
@@ -67,11 +79,24 @@ struct SearchResult {
 };
 
 struct SearchMetrics {
-    int alpha_cutoffs = 0;
-    int beta_cutoffs = 0;
-    int nodes = 0;
-    int lnodes = 0;
-    int qnodes = 0;
+    s64 alpha_cutoffs = 0;
+    s64 beta_cutoffs = 0;
+    s64 nodes = 0;
+    s64 lnodes = 0;
+    s64 qnodes = 0;
+    s64 tt_hits = 0;
+    s64 researches = 0; // PVS null window searches that had to be repeated
+    s64 null_cutoffs = 0;
+    s64 lmr_researches = 0; // reduced searches that beat alpha and were repeated at full depth
+    s64 lmp_pruned = 0;
+    s64 check_extensions = 0;
+    s64 rfp_cutoffs = 0;
+    s64 razored = 0;
+    s64 futility_pruned = 0;
+    s64 iid_searches = 0;
+    s64 singular_extensions = 0;
+    s64 move_cutoffs = 0; // beta cutoffs by a searched move, not the TT or a pruning rule
+    s64 first_move_cutoffs = 0; // ... by the first move searched, a measure of move ordering
     PV pv;
 };
 
@@ -88,10 +113,169 @@ struct MoveInfo {
     MoveInfo* next;
 };
 
+// Zobrist hashes of the positions leading up to the one being searched, for
+// repetition detection. The game part comes from the UCI "position" command
+// and is shared, read only, by all search threads. Each thread pushes and
+// pops its own search path on top of it.
+class HashHistory {
+public:
+    // `game` is the hashes of the positions before the root, oldest first,
+    // and must outlive the search
+    void reset(const std::vector<u64>* game) noexcept
+    {
+        _game = game;
+        _count = 0;
+    }
+
+    // call with the hash of the position a move is made from
+    void push(u64 hash) noexcept
+    {
+        assert(_count < static_cast<int>(_search.size()));
+        _search[_count++] = hash;
+    }
+
+    void pop() noexcept
+    {
+        assert(_count > 0);
+        --_count;
+    }
+
+    // True if the position with `hash` occurred before, going back no further
+    // than the last capture or pawn move (`halfmoves` plies)
+    [[nodiscard]]
+    bool is_repetition(u64 hash, int halfmoves) const noexcept;
+
+private:
+    const std::vector<u64>*   _game = nullptr;
+    std::array<u64, MAX_DEPTH> _search;
+    int                        _count = 0;
+};
+
+// Parameters from the UCI "go" command. Times are in milliseconds, 0 means
+// the limit wasn't given.
+struct SearchLimits {
+    s64  time[2] = {0, 0};
+    s64  inc[2] = {0, 0};
+    int  movestogo = 0;
+    s64  movetime = 0;
+    int  depth = 0;
+    s64  nodes = 0;
+    int  mate = 0;
+    bool infinite = false;
+    // search the opponent's time, the limits only apply after ponderhit
+    bool ponder = false;
+    // only search these root moves, all of them when empty
+    std::vector<Move> searchmoves;
+
+    // engine option, subtracted from the clock to allow for GUI/network lag
+    s64  move_overhead = 30;
+    // engine option, the number of best root moves to find and report
+    int  multipv = 1;
+};
+
+// Called after every completed iteration with the depth, and for each of the
+// MultiPV lines, best first, its rank (from 1), the score from the side to
+// move's point of view, the line and the number of nodes searched by all
+// threads.
+using InfoCallback = std::function<void(int depth, int multipv, int score, const Line& pv,
+        const SearchMetrics& metrics, s64 nodes)>;
+
+// Per-searcher state. With several threads (Lazy SMP) each one has its own
+// context and they only share the TT and the stop flag.
+struct SearchContext {
+    TT*                tt = nullptr;
+    std::atomic<bool>* stop = nullptr;
+    // set while pondering, cleared by "ponderhit"
+    std::atomic<bool>* ponder = nullptr;
+    InfoCallback       info;
+    SearchMetrics      metrics;
+    SearchLimits       limits;
+    TimeManager        time;
+    bool               halted = false;
+    // this search still thinks it's pondering, see pondering()
+    bool               pondering = false;
+    HashHistory        hashes;
+
+    // move ordering, indexed by ply for the killers. History and counter
+    // moves carry over from one search to the next.
+    History                         history;
+    CounterMoves                    counters;
+    std::array<Killers, MAX_DEPTH>  killers;
+
+    // move left out of the node at each ply, by the singular extension search
+    std::array<Move, MAX_DEPTH>     excluded;
+    // depth of the current iteration
+    int                             root_depth = 0;
+
+    // 0 is the main thread, helpers are numbered from 1
+    int                                thread_id = 0;
+    // every thread searching the same position, including this one
+    const std::vector<SearchContext*>* threads = nullptr;
+    // nodes searched so far, published for the other threads to read
+    std::atomic<s64>                   nodes{0};
+
+    // nodes searched by all threads
+    s64 total_nodes() const noexcept
+    {
+        if (!threads) {
+            return nodes.load(std::memory_order_relaxed);
+        }
+        s64 total = 0;
+        for (const SearchContext* ctx : *threads) {
+            total += ctx->nodes.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    bool stopped() const noexcept
+    { return halted || (stop && stop->load(std::memory_order_relaxed)); }
+
+    // stop this search, and anyone else watching the same stop flag
+    void halt() noexcept
+    {
+        halted = true;
+        if (stop) {
+            stop->store(true, std::memory_order_relaxed);
+        }
+    }
+};
+
 std::ostream& operator<<(std::ostream& os, const SearchMetrics& metrics);
 
-SearchResult search(Position& position, TT* tt, int depth, SearchMetrics& metrics, Line& pline);
+// score for giving mate / being mated `ply` plies from the root
+constexpr int mate_in(int ply) noexcept
+{ return CHECKMATE - ply; }
+constexpr int mated_in(int ply) noexcept
+{ return -CHECKMATE + ply; }
+
+bool is_mate_score(int score) noexcept;
+
+// Moves until mate for a mate score, as UCI "score mate" reports it: positive
+// when the side to move gives mate, negative when it is getting mated.
+int mate_distance(int score) noexcept;
+
+// Rebuild the late move reduction table, where the reduction for the
+// `moveno`th move at `depth` is
+//
+//   base/100 + ln(depth) * ln(moveno) / (divisor/100)
+//
+// It's built with LMR_BASE and LMR_DIVISOR at startup. Must not be called
+// while searching.
+void init_reductions(int base, int divisor) noexcept;
+
+// Search `position` within `limits`. With `limits.multipv` > 1 the best that
+// many root moves are ranked, each searched with the ones ranked above it
+// left out. The caller is expected to have called
+// `TT::new_search()` on `ctx.tt`, once for all threads, and to have reset
+// `ctx.hashes` with the game history. The move is MOVE_NONE when there are no
+// legal moves.
+SearchResult search(Position& position, SearchContext& ctx, const SearchLimits& limits, Line& pline);
 
+// Search `position` with a fresh context and TT, to depth 4 or within
+// `limits`. `game` is the hashes of the positions played before it, and
+// `info` is called as for search().
 SearchResult easy_search(Position& position, bool useTT = true);
+SearchResult easy_search(Position& position, const SearchLimits& limits, const std::vector<u64>* game = nullptr,
+        InfoCallback info = nullptr);
 
 } // namespace lesschess
@@ -111,7 +111,7 @@ TEST_CASE("White mate in 1 with rook", "[search]")
     auto result   = easy_search(position);
     auto expected = Move{H6, H8};
     REQUIRE(result.move == expected);
-    REQUIRE(result.score == WHITE_CHECKMATE);
+    REQUIRE(result.score == mate_in(1));
 }
 
 TEST_CASE("Black mate in 1 with rook", "[search]")
@@ -132,7 +132,7 @@ TEST_CASE("Black mate in 1 with rook", "[search]")
     auto result   = easy_search(position);
     auto expected = Move{H3, H1};
     REQUIRE(result.move == expected);
-    REQUIRE(result.score == BLACK_CHECKMATE);
+    REQUIRE(result.score == -mate_in(1));
 }
 
 TEST_CASE("Black mate in 2 with rook", "[search]")
@@ -143,7 +143,7 @@ TEST_CASE("Black mate in 2 with rook", "[search]")
     auto result   = easy_search(position);
     auto expected = Move{B4, B3};
     REQUIRE(result.move  == expected);
-    REQUIRE(result.score == BLACK_CHECKMATE);
+    REQUIRE(result.score == -mate_in(3));
 }
 
 TEST_CASE("Black stalemate white king", "[search]")
@@ -165,7 +165,7 @@ TEST_CASE("White mate -- philidor's smothered mate", "[search]")
     auto result   = easy_search(position);
     auto expected = Move{C4, G8};
     REQUIRE(result.move  == expected);
-    REQUIRE(result.score == CHECKMATE);
+    REQUIRE(result.score == mate_in(3));
 }
 
 TEST_CASE("White mate in 2 utilizing pin")
@@ -177,7 +177,7 @@ TEST_CASE("White mate in 2 utilizing pin")
     auto result   = easy_search(position);
     auto expected = Move{D2, H6};
     REQUIRE(result.move  == expected);
-    REQUIRE(result.score == CHECKMATE);
+    REQUIRE(result.score == mate_in(3));
 }
 
 TEST_CASE("Knight fork reduced")
@@ -234,7 +234,7 @@ TEST_CASE("Tactics")
         auto result   = easy_search(position);
         auto expected = Move{E5, G6};
         REQUIRE(result.move  == expected);
-        REQUIRE(result.score == WHITE_CHECKMATE);
+        REQUIRE(result.score == mate_in(3));
     }
 
     SECTION("Black mate in 2 with knights")
@@ -244,7 +244,7 @@ TEST_CASE("Tactics")
         auto result   = easy_search(position);
         auto expected = Move{E4, G3};
         REQUIRE(result.move  == expected);
-        REQUIRE(result.score == BLACK_CHECKMATE);
+        REQUIRE(result.score == -mate_in(3));
     }
 
     SECTION("White mate with bishop")
@@ -254,7 +254,7 @@ TEST_CASE("Tactics")
         auto result   = easy_search(position);
         auto expected = Move{C4, D5};
         REQUIRE(result.move  == expected);
-        REQUIRE(result.score == WHITE_CHECKMATE);
+        REQUIRE(result.score == mate_in(3));
     }
 
     SECTION("White mate after queen sac")
@@ -264,7 +264,7 @@ TEST_CASE("Tactics")
         auto result   = easy_search(position);
         auto expected = Move{B1, F1};
         REQUIRE(result.move  == expected);
-        REQUIRE(result.score == WHITE_CHECKMATE);
+        REQUIRE(result.score == mate_in(3));
     }
 
     std::vector<std::pair<std::string, Move>> white_checkmate_yacpdb_positions = {
@@ -290,7 +290,7 @@ TEST_CASE("Tactics")
             auto result   = easy_search(position);
             auto expected = p.second;
             REQUIRE(result.move  == expected);
-            REQUIRE(result.score == WHITE_CHECKMATE);
+            REQUIRE(result.score == mate_in(3));
         }
     }
 
@@ -301,6 +301,191 @@ TEST_CASE("Tactics")
         auto ex1 = Move::make_promotion(F7, F8, QUEEN);
         auto ex2 = Move::make_promotion(F7, F8, ROOK);
         REQUIRE((result.move  == ex1 || result.move == ex2));
-        REQUIRE(result.score == WHITE_CHECKMATE);
+        REQUIRE(result.score == mate_in(3));
     }
 }
+
+TEST_CASE("HashHistory repetitions", "[search]")
+{
+    Zobrist::initialize();
+
+    Position position = Position::from_fen(start_position_fen);
+    std::vector<u64> game;
+    Savepos sp;
+    auto play = [&](const char* move) {
+        game.push_back(position.zobrist_hash());
+        position.make_move(sp, position.move_from_long_algebraic(move));
+    };
+    HashHistory hashes;
+    auto repeated = [&]() {
+        hashes.reset(&game);
+        return hashes.is_repetition(position.zobrist_hash(), position.fifty_move_rule_moves());
+    };
+
+    play("g1f3");
+    REQUIRE(repeated() == false);
+    play("g8f6");
+    REQUIRE(repeated() == false);
+    play("f3g1");
+    REQUIRE(repeated() == false);
+    play("f6g8");
+    REQUIRE(repeated() == true);
+
+    // a pawn move can't be undone, nothing before it can repeat
+    play("e2e3");
+    play("g8f6");
+    play("g1f3");
+    play("f6g8");
+    REQUIRE(repeated() == false);
+    play("f3g1");
+    REQUIRE(repeated() == true);
+
+    // the search path is looked at before the game
+    hashes.reset(&game);
+    Position searched = position;
+    for (const char* move : { "g8f6", "g1f3", "f6g8", "f3g1" }) {
+        hashes.push(searched.zobrist_hash());
+        searched.make_move(sp, searched.move_from_long_algebraic(move));
+    }
+    REQUIRE(hashes.is_repetition(searched.zobrist_hash(), searched.fifty_move_rule_moves()) == true);
+    // but not if there was an irreversible move in between
+    REQUIRE(hashes.is_repetition(searched.zobrist_hash(), 2) == false);
+}
+
+TEST_CASE("Search sees repetition draws", "[search]")
+{
+    Zobrist::initialize();
+
+    // white is a queen down, but going back with the knight repeats the
+    // position from two moves ago
+    Position position = Position::from_fen("3qk1n1/8/8/8/8/8/8/4K1N1 w - - 0 1");
+    std::vector<u64> game;
+    Savepos sp;
+    for (const char* move : { "g1f3", "g8f6", "f3g1", "f6g8", "g1f3", "g8f6" }) {
+        game.push_back(position.zobrist_hash());
+        position.make_move(sp, position.move_from_long_algebraic(move));
+    }
+
+    SearchLimits limits;
+    limits.depth = 4;
+    auto result = easy_search(position, limits, &game);
+    REQUIRE(result.move == Move(F3, G1));
+    REQUIRE(result.score == DRAW);
+}
+
+TEST_CASE("Mate scores", "[search]")
+{
+    REQUIRE(mate_distance(mate_in(1)) == 1);
+    REQUIRE(mate_distance(mate_in(3)) == 2);
+    REQUIRE(mate_distance(mated_in(2)) == -1);
+    REQUIRE(mate_distance(mated_in(4)) == -2);
+    REQUIRE(mate_in(1) > mate_in(3));
+    REQUIRE(is_mate_score(mate_in(MAX_DEPTH - 1)));
+    REQUIRE(is_mate_score(mated_in(MAX_DEPTH - 1)));
+    REQUIRE(!is_mate_score(10000));
+}
+
+TEST_CASE("Search prefers the shortest mate", "[search]")
+{
+    Zobrist::initialize();
+
+    // Ra8 or Qa8 mates now, there are plenty of slower mates too
+    auto position = Position::from_fen("6k1/5ppp/8/8/8/8/Q7/R5K1 w - - 0 1");
+    SearchLimits limits;
+    limits.depth = 5;
+    auto result = easy_search(position, limits);
+    REQUIRE((result.move == Move(A1, A8) || result.move == Move(A2, A8)));
+    REQUIRE(result.score == mate_in(1));
+}
+
+TEST_CASE("Checks are resolved at the horizon", "[search]")
+{
+    Zobrist::initialize();
+
+    // a depth 1 search sees the back rank mate, the reply to the check is
+    // searched instead of standing pat
+    auto position = Position::from_fen("6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1");
+    SearchLimits limits;
+    limits.depth = 1;
+    auto result = easy_search(position, limits);
+    REQUIRE(result.move == Move(A1, A8));
+    REQUIRE(result.score == mate_in(1));
+}
+
+TEST_CASE("MultiPV ranks the best root moves", "[search]")
+{
+    Zobrist::initialize();
+
+    // taking the queen is best, then the rook, then anything that keeps the
+    // knight
+    auto position = Position::from_fen("4k3/8/8/1n1q1r2/8/4N3/8/4K3 w - - 0 1");
+    std::vector<std::pair<Move, int>> last;
+    int last_depth = 0;
+    auto info = [&](int depth, int multipv, int score, const Line& pv, const SearchMetrics&, s64) {
+        if (depth != last_depth) {
+            last.clear();
+            last_depth = depth;
+        }
+        REQUIRE(multipv == static_cast<int>(last.size()) + 1);
+        REQUIRE(pv.count > 0);
+        last.emplace_back(pv.moves[0], score);
+    };
+    SearchLimits limits;
+    limits.depth = 4;
+    limits.multipv = 3;
+    auto result = easy_search(position, limits, nullptr, info);
+    REQUIRE(last_depth == 4);
+    REQUIRE(last.size() == 3);
+    REQUIRE(last[0].first == Move(E3, D5));
+    REQUIRE(last[1].first == Move(E3, F5));
+    REQUIRE(last[2].first != Move(E3, D5));
+    REQUIRE(last[2].first != Move(E3, F5));
+    REQUIRE(last[0].second >= last[1].second);
+    REQUIRE(last[1].second >= last[2].second);
+    REQUIRE(result.move == Move(E3, D5));
+}
+
+TEST_CASE("searchmoves restricts the root moves", "[search]")
+{
+    Zobrist::initialize();
+
+    // the back rank mate isn't one of the moves to search
+    auto position = Position::from_fen("6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1");
+    SearchLimits limits;
+    limits.depth = 3;
+    limits.searchmoves = { Move(A1, A2), Move(G1, F1) };
+    auto result = easy_search(position, limits);
+    REQUIRE((result.move == Move(A1, A2) || result.move == Move(G1, F1)));
+    REQUIRE(!is_mate_score(result.score));
+}
+
+TEST_CASE("Search with no legal moves", "[search]")
+{
+    Zobrist::initialize();
+
+    // fool's mate, white is checkmated
+    auto mated = Position::from_fen("rnb1kbnr/pppp1ppp/8/4p3/6Pq/5P2/PPPPP2P/RNBQKBNR w KQkq - 1 3");
+    auto result = easy_search(mated);
+    REQUIRE(result.move == MOVE_NONE);
+    REQUIRE(result.score == mated_in(0));
+
+    auto stalemate = Position::from_fen("7k/5Q2/6K1/8/8/8/8/8 b - - 0 1");
+    result = easy_search(stalemate);
+    REQUIRE(result.move == MOVE_NONE);
+    REQUIRE(result.score == STALEMATE);
+}
+
+TEST_CASE("Extensions stay within MAX_DEPTH", "[search]")
+{
+    Zobrist::initialize();
+
+    // Philidor's smothered mate: every white move is a check with a single
+    // reply, so both the check and the singular extension apply all the way
+    // down. negamax asserts the depth stays in range.
+    auto position = Position::from_fen("1r5k/6pp/7N/8/2Q5/8/8/7K w - - 0 1");
+    SearchLimits limits;
+    limits.depth = MAX_DEPTH - 1;
+    auto result = easy_search(position, limits);
+    REQUIRE(result.move == Move(C4, G8));
+    REQUIRE(result.score == mate_in(3));
+}
@@ -0,0 +1,194 @@
+#include "thread.h"
+#include <algorithm>
+
+namespace lesschess {
+
+SearchThread::SearchThread(ThreadPool& pool, int id)
+    : _pool{pool}
+{
+    _ctx.thread_id = id;
+    _thread = std::thread(&SearchThread::_idle_loop, this);
+}
+
+SearchThread::~SearchThread()
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this]() { return !_searching; });
+        _exit = true;
+    }
+    _cv.notify_all();
+    _thread.join();
+}
+
+void SearchThread::start()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _searching = true;
+    }
+    _cv.notify_all();
+}
+
+void SearchThread::wait()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait(lock, [this]() { return !_searching; });
+}
+
+bool SearchThread::searching()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _searching;
+}
+
+void SearchThread::_idle_loop()
+{
+    for (;;) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this]() { return _searching || _exit; });
+        if (_exit) {
+            return;
+        }
+        lock.unlock();
+
+        _pool._search(*this);
+
+        lock.lock();
+        _searching = false;
+        lock.unlock();
+        _cv.notify_all();
+    }
+}
+
+ThreadPool::ThreadPool(int nthreads)
+{
+    resize(nthreads);
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop();
+    wait();
+    _threads.clear();
+}
+
+void ThreadPool::resize(int nthreads)
+{
+    nthreads = std::clamp(nthreads, 1, MaxThreads);
+    wait();
+    _threads.clear();
+    _contexts.clear();
+    for (int id = 0; id < nthreads; ++id) {
+        _threads.push_back(std::make_unique<SearchThread>(*this, id));
+        _contexts.push_back(&_threads.back()->context());
+    }
+}
+
+void ThreadPool::go(const Position& position, const std::vector<u64>& game_hashes, TT* tt,
+        const SearchLimits& limits, InfoCallback info, DoneCallback done)
+{
+    wait();
+
+    // helpers have no limits of their own, they run until the main thread
+    // stops them
+    SearchLimits helper_limits;
+    helper_limits.depth = limits.depth;
+    helper_limits.mate = limits.mate;
+    helper_limits.searchmoves = limits.searchmoves;
+
+    if (tt) {
+        tt->new_search();
+    }
+    _game_hashes = game_hashes;
+    for (auto& thread : _threads) {
+        SearchContext& ctx = thread->context();
+        thread->position() = position;
+        ctx.hashes.reset(&_game_hashes);
+        ctx.tt = tt;
+        ctx.stop = &_stop;
+        ctx.ponder = &_ponder;
+        ctx.threads = &_contexts;
+        ctx.limits = ctx.thread_id == 0 ? limits : helper_limits;
+        ctx.info = ctx.thread_id == 0 ? info : nullptr;
+        // the main thread checks the node limit against every thread's count
+        // before the helpers have started and cleared their own
+        ctx.nodes.store(0, std::memory_order_relaxed);
+    }
+    _done = std::move(done);
+    _stop.store(false, std::memory_order_relaxed);
+    _ponder.store(limits.ponder, std::memory_order_relaxed);
+    _threads[0]->start();
+}
+
+void ThreadPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop.store(true, std::memory_order_relaxed);
+    }
+    _cv.notify_all();
+}
+
+void ThreadPool::ponderhit()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _ponder.store(false, std::memory_order_relaxed);
+    }
+    _cv.notify_all();
+}
+
+void ThreadPool::wait()
+{
+    if (!_threads.empty()) {
+        _threads[0]->wait();
+    }
+}
+
+bool ThreadPool::searching()
+{
+    return _threads[0]->searching();
+}
+
+void ThreadPool::_search(SearchThread& thread)
+{
+    SearchContext& ctx = thread.context();
+    const SearchLimits limits = ctx.limits;
+    Line pv;
+
+    if (ctx.thread_id != 0) {
+        search(thread.position(), ctx, limits, pv);
+        return;
+    }
+
+    for (size_t i = 1; i < _threads.size(); ++i) {
+        _threads[i]->start();
+    }
+
+    SearchResult result = search(thread.position(), ctx, limits, pv);
+
+    // in infinite mode bestmove can't be sent until the GUI says stop, and
+    // when pondering not until stop or ponderhit, even if the search ran out
+    // of depth or found a mate
+    if (limits.infinite || limits.ponder) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this, &limits]() {
+            return _stop.load(std::memory_order_relaxed) ||
+                (!limits.infinite && !_ponder.load(std::memory_order_relaxed));
+        });
+    }
+
+    // the helpers are stopped before bestmove so they're done with the TT
+    // and the position by the time the next command arrives
+    _stop.store(true, std::memory_order_relaxed);
+    for (size_t i = 1; i < _threads.size(); ++i) {
+        _threads[i]->wait();
+    }
+
+    if (_done) {
+        _done(result, pv);
+    }
+}
+
+} // ~namespace lesschess
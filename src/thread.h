@@ -0,0 +1,120 @@
+#pragma once
+
+#include "search.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lesschess {
+
+class ThreadPool;
+
+// One searcher. Each thread has its own copy of the root position and its own
+// SearchContext, which lives as long as the thread does.
+class SearchThread {
+public:
+    SearchThread(ThreadPool& pool, int id);
+    ~SearchThread();
+
+    SearchThread(const SearchThread&) = delete;
+    SearchThread& operator=(const SearchThread&) = delete;
+
+    // Wake up and run one search, returns immediately.
+    void start();
+
+    // Block until this thread's search, if any, has finished.
+    void wait();
+
+    [[nodiscard]]
+    bool searching();
+
+    Position& position() noexcept
+    { return _position; }
+
+    SearchContext& context() noexcept
+    { return _ctx; }
+
+private:
+    void _idle_loop();
+
+    ThreadPool&             _pool;
+    Position                _position;
+    SearchContext           _ctx;
+
+    std::mutex              _mutex;
+    std::condition_variable _cv;
+    bool                    _searching = false;
+    bool                    _exit = false;
+    std::thread             _thread;
+};
+
+// Runs searches on dedicated threads so the UCI loop can keep reading
+// commands (stop, isready, ...) while the engine is thinking.
+//
+// With more than one thread the search is Lazy SMP: thread 0 is the main
+// thread, it owns the clock and reports info/bestmove. The helpers search
+// the same position until the main thread is done, and only help it through
+// the entries they leave in the shared TT.
+class ThreadPool {
+public:
+    // Called on the main search thread when a search finishes or is stopped.
+    using DoneCallback = std::function<void(const SearchResult& result, const Line& pv)>;
+
+    constexpr static int MaxThreads = 256;
+
+    explicit ThreadPool(int nthreads=1);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Change the number of threads, waits for any search to finish first.
+    void resize(int nthreads);
+
+    [[nodiscard]]
+    int size() const noexcept
+    { return static_cast<int>(_threads.size()); }
+
+    // Start searching `position` within `limits` and return immediately.
+    // `game_hashes` are the hashes of the positions played before it, for
+    // repetition detection. Waits for any previous search to finish first.
+    void go(const Position& position, const std::vector<u64>& game_hashes, TT* tt, const SearchLimits& limits,
+            InfoCallback info, DoneCallback done);
+
+    // Ask the current search to finish as soon as possible. The result from
+    // the last completed iteration is still reported through DoneCallback.
+    void stop();
+
+    // The opponent played the move the search was pondering on, switch to a
+    // normal search within the limits given to go().
+    void ponderhit();
+
+    // Block until the current search, if any, has finished.
+    void wait();
+
+    [[nodiscard]]
+    bool searching();
+
+private:
+    friend class SearchThread;
+
+    // body of one search on `thread`, called from its idle loop
+    void _search(SearchThread& thread);
+
+    std::vector<std::unique_ptr<SearchThread>> _threads;
+    std::vector<SearchContext*>                _contexts;
+    // one copy of the game history for all threads
+    std::vector<u64>                           _game_hashes;
+
+    std::mutex              _mutex;
+    std::condition_variable _cv;
+    std::atomic<bool>       _stop{false};
+    std::atomic<bool>       _ponder{false};
+    DoneCallback            _done;
+};
+
+} // ~namespace lesschess
@@ -0,0 +1,115 @@
+#include "catch.hpp"
+#include "thread.h"
+#include <chrono>
+#include <mutex>
+
+using namespace lesschess;
+
+// What the main thread reported, filled in by the callbacks.
+struct Report {
+    std::mutex   mutex;
+    int          depth = 0;
+    Move         move = MOVE_NONE;
+    s64          nodes = 0;
+    s64          main_nodes = 0;
+    int          done = 0;
+    SearchResult result;
+    Line         pv;
+
+    ThreadPool::DoneCallback done_callback()
+    {
+        return [this](const SearchResult& r, const Line& line) {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++done;
+            result = r;
+            pv = line;
+        };
+    }
+
+    InfoCallback info_callback()
+    {
+        return [this](int d, int, int, const Line& line, const SearchMetrics& metrics, s64 n) {
+            std::lock_guard<std::mutex> lock(mutex);
+            depth = d;
+            move = line.moves[0];
+            nodes = n;
+            main_nodes = metrics.nodes + metrics.qnodes;
+        };
+    }
+
+    int completed_depth()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return depth;
+    }
+};
+
+TEST_CASE("ThreadPool depth limit", "[thread]")
+{
+    Zobrist::initialize();
+    TT tt{TT::MinSizeMB};
+    ThreadPool pool{4};
+    REQUIRE(pool.size() == 4);
+
+    auto position = Position::from_fen("1r5k/6pp/7N/8/2Q5/8/8/7K w - - 0 1");
+    SearchLimits limits;
+    limits.depth = 6;
+    Report report;
+    pool.go(position, {}, &tt, limits, report.info_callback(), report.done_callback());
+    pool.wait();
+
+    // the helpers are depth limited too, and stopped when the main thread is
+    // done, so the pool is idle once wait() returns
+    REQUIRE(!pool.searching());
+    REQUIRE(report.done == 1);
+    REQUIRE(report.depth == 6);
+    REQUIRE(report.result.move == Move(C4, G8));
+    REQUIRE(report.result.score == mate_in(3));
+    REQUIRE(report.pv.moves[0] == Move(C4, G8));
+}
+
+TEST_CASE("ThreadPool stop", "[thread]")
+{
+    Zobrist::initialize();
+    TT tt{TT::MinSizeMB};
+    ThreadPool pool{3};
+
+    auto position = Position::from_fen("r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3");
+    SearchLimits limits;
+    limits.infinite = true;
+    Report report;
+    pool.go(position, {}, &tt, limits, report.info_callback(), report.done_callback());
+
+    // the search never stops on its own in infinite mode
+    while (report.completed_depth() < 5) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(pool.searching());
+
+    // neither the main thread nor the helpers have a limit, wait() only
+    // returns if all of them see the stop
+    auto start = std::chrono::steady_clock::now();
+    pool.stop();
+    pool.wait();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    REQUIRE(elapsed < std::chrono::seconds(5));
+    REQUIRE(!pool.searching());
+
+    // bestmove comes from the last completed iteration, which the helpers
+    // contributed nodes to
+    REQUIRE(report.done == 1);
+    REQUIRE(report.depth >= 5);
+    REQUIRE(report.result.move != MOVE_NONE);
+    REQUIRE(report.result.move == report.move);
+    REQUIRE(report.pv.moves[0] == report.move);
+    REQUIRE(report.nodes > report.main_nodes);
+
+    // the pool can search again after a stop
+    report.done = 0;
+    limits.infinite = false;
+    limits.depth = 3;
+    pool.go(position, {}, &tt, limits, nullptr, report.done_callback());
+    pool.wait();
+    REQUIRE(report.done == 1);
+    REQUIRE(report.result.move != MOVE_NONE);
+}
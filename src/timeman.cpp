@@ -0,0 +1,65 @@
+#include "timeman.h"
+#include "search.h"
+#include <algorithm>
+
+namespace lesschess {
+
+// number of moves assumed to be left in the game when playing sudden death
+constexpr int SUDDEN_DEATH_MOVES_TO_GO = 30;
+constexpr int MAX_MOVES_TO_GO = 50;
+
+void TimeManager::init(const SearchLimits& limits, Color us) noexcept
+{
+    _start = Clock::now();
+    _soft = 0;
+    _hard = 0;
+
+    if (limits.movetime > 0) {
+        _soft = std::max<s64>(limits.movetime - limits.move_overhead, 1);
+        _hard = _soft;
+        return;
+    }
+
+    // no clock at all: depth, nodes, mate or infinite. A clock that has run
+    // out (zero or negative, with the other side's clock or an increment
+    // given) still gets the minimal budget below instead of no limit.
+    if (limits.time[WHITE] == 0 && limits.time[BLACK] == 0 && limits.inc[us] == 0) {
+        return;
+    }
+
+    const s64 inc = limits.inc[us];
+    const s64 available = std::max<s64>(limits.time[us] - limits.move_overhead, 1);
+    const int movestogo = limits.movestogo > 0 ?
+        std::min(limits.movestogo, MAX_MOVES_TO_GO) : SUDDEN_DEATH_MOVES_TO_GO;
+
+    // never plan to use more than this in one move, leaving some slack for
+    // the remaining moves in the time control unless this is the last one
+    const s64 maximum = movestogo == 1 ? available * 9 / 10 : available / 2;
+
+    _soft = available / movestogo + inc * 3 / 4;
+    _hard = std::min(_soft * 4, maximum);
+    _soft = std::max<s64>(std::min(_soft, _hard), 1);
+    _hard = std::max<s64>(_hard, 1);
+}
+
+bool TimeManager::start_next_iteration(s64 prev_iteration_msecs, s64 last_iteration_msecs) const noexcept
+{
+    if (!enabled()) {
+        return true;
+    }
+
+    s64 now = elapsed();
+    if (now >= _soft) {
+        return false;
+    }
+
+    // effective branching factor measured from the last two iterations
+    double ebf = 2.0;
+    if (prev_iteration_msecs > 0 && last_iteration_msecs > 0) {
+        ebf = std::clamp(static_cast<double>(last_iteration_msecs) / prev_iteration_msecs, 1.5, 6.0);
+    }
+    s64 estimate = static_cast<s64>(last_iteration_msecs * ebf);
+    return now + estimate <= _hard;
+}
+
+} // ~namespace lesschess
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "move.h"
+#include <chrono>
+
+namespace lesschess {
+
+struct SearchLimits;
+
+// Turns the UCI clock parameters into deadlines for one search.
+//
+//   soft limit: don't start another iteration once this has passed
+//   hard limit: abort the search in progress, checked from inside negamax
+//
+class TimeManager {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void init(const SearchLimits& limits, Color us) noexcept;
+
+    // Start the clock again from now, keeping the limits. When pondering the
+    // clock only starts running on "ponderhit".
+    void restart() noexcept
+    { _start = Clock::now(); }
+
+    // milliseconds since init()
+    [[nodiscard]]
+    s64 elapsed() const noexcept
+    {
+        auto dt = Clock::now() - _start;
+        return std::chrono::duration_cast<std::chrono::milliseconds>(dt).count();
+    }
+
+    [[nodiscard]]
+    bool enabled() const noexcept
+    { return _hard > 0; }
+
+    [[nodiscard]]
+    s64 soft_limit() const noexcept
+    { return _soft; }
+
+    [[nodiscard]]
+    s64 hard_limit() const noexcept
+    { return _hard; }
+
+    [[nodiscard]]
+    bool hard_limit_reached() const noexcept
+    { return enabled() && elapsed() >= _hard; }
+
+    // Is the next iteration likely to finish before the hard limit, given how
+    // long the last two iterations took?
+    [[nodiscard]]
+    bool start_next_iteration(s64 prev_iteration_msecs, s64 last_iteration_msecs) const noexcept;
+
+private:
+    Clock::time_point _start = Clock::now();
+    s64               _soft = 0;
+    s64               _hard = 0;
+};
+
+} // ~namespace lesschess
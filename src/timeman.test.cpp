@@ -0,0 +1,149 @@
+#include "catch.hpp"
+#include "timeman.h"
+#include "search.h"
+#include <chrono>
+#include <thread>
+
+using namespace lesschess;
+
+TEST_CASE("TimeManager without a clock", "[timeman]")
+{
+    TimeManager time;
+    SearchLimits limits;
+    limits.depth = 5;
+    time.init(limits, WHITE);
+    REQUIRE(time.enabled() == false);
+    REQUIRE(time.hard_limit_reached() == false);
+    REQUIRE(time.start_next_iteration(1000000, 1000000) == true);
+}
+
+TEST_CASE("TimeManager movetime", "[timeman]")
+{
+    TimeManager time;
+    SearchLimits limits;
+    limits.movetime = 1000;
+    limits.move_overhead = 30;
+    time.init(limits, WHITE);
+    REQUIRE(time.enabled());
+    REQUIRE(time.soft_limit() == 970);
+    REQUIRE(time.hard_limit() == 970);
+
+    // movetime wins over the clock
+    limits.time[WHITE] = 60000;
+    time.init(limits, WHITE);
+    REQUIRE(time.soft_limit() == 970);
+    REQUIRE(time.hard_limit() == 970);
+
+    // the overhead never takes it to zero, which would mean no limit
+    limits.movetime = 10;
+    time.init(limits, WHITE);
+    REQUIRE(time.enabled());
+    REQUIRE(time.soft_limit() == 1);
+    REQUIRE(time.hard_limit() == 1);
+}
+
+TEST_CASE("TimeManager clock", "[timeman]")
+{
+    TimeManager time;
+    SearchLimits limits;
+    limits.time[WHITE] = 60000;
+    limits.time[BLACK] = 1000;
+    limits.move_overhead = 30;
+
+    SECTION("sudden death") {
+        // 59970 available over 30 moves, at most 4x that or half the clock
+        time.init(limits, WHITE);
+        REQUIRE(time.soft_limit() == 1999);
+        REQUIRE(time.hard_limit() == 7996);
+    }
+
+    SECTION("move overhead") {
+        limits.move_overhead = 0;
+        time.init(limits, WHITE);
+        REQUIRE(time.soft_limit() == 2000);
+        REQUIRE(time.hard_limit() == 8000);
+    }
+
+    SECTION("increment") {
+        limits.inc[WHITE] = 1000;
+        limits.inc[BLACK] = 5000;
+        time.init(limits, WHITE);
+        REQUIRE(time.soft_limit() == 1999 + 750);
+        REQUIRE(time.hard_limit() == 4 * (1999 + 750));
+
+        // the increment can't take it past half the clock
+        time.init(limits, BLACK);
+        REQUIRE(time.soft_limit() == 485);
+        REQUIRE(time.hard_limit() == 485);
+    }
+
+    SECTION("movestogo") {
+        limits.movestogo = 10;
+        time.init(limits, WHITE);
+        REQUIRE(time.soft_limit() == 5997);
+        REQUIRE(time.hard_limit() == 23988);
+
+        limits.movestogo = 100;
+        time.init(limits, WHITE);
+        REQUIRE(time.soft_limit() == 1199);
+        REQUIRE(time.hard_limit() == 4796);
+
+        // the last move before the time control can use most of the clock
+        limits.movestogo = 1;
+        time.init(limits, WHITE);
+        REQUIRE(time.soft_limit() == 53973);
+        REQUIRE(time.hard_limit() == 53973);
+    }
+
+    SECTION("clock ran out") {
+        limits.time[WHITE] = 0;
+        time.init(limits, WHITE);
+        REQUIRE(time.enabled());
+        REQUIRE(time.soft_limit() == 1);
+        REQUIRE(time.hard_limit() == 1);
+
+        limits.time[WHITE] = -500;
+        time.init(limits, WHITE);
+        REQUIRE(time.enabled());
+        REQUIRE(time.soft_limit() == 1);
+        REQUIRE(time.hard_limit() == 1);
+    }
+}
+
+TEST_CASE("TimeManager start_next_iteration", "[timeman]")
+{
+    TimeManager time;
+    SearchLimits limits;
+    limits.time[WHITE] = 60000;
+    limits.time[BLACK] = 60000;
+    limits.move_overhead = 30;
+    time.init(limits, WHITE);
+    REQUIRE(time.hard_limit() == 7996);
+
+    // next iteration estimated from the ratio of the last two, 1.5-6x
+    REQUIRE(time.start_next_iteration(100, 200));
+    REQUIRE(!time.start_next_iteration(1000, 3000));
+    REQUIRE(!time.start_next_iteration(100, 1500));
+    REQUIRE(time.start_next_iteration(3000, 1000));
+    REQUIRE(!time.start_next_iteration(6000, 6000));
+
+    // 2x without a previous iteration
+    REQUIRE(time.start_next_iteration(0, 3000));
+    REQUIRE(!time.start_next_iteration(0, 4500));
+
+    // never once the soft limit has passed
+    limits.movetime = 31;
+    time.init(limits, WHITE);
+    REQUIRE(time.hard_limit() == 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    REQUIRE(time.hard_limit_reached());
+    REQUIRE(!time.start_next_iteration(0, 0));
+
+    // restart() starts the clock again
+    limits.movetime = 10030;
+    time.init(limits, WHITE);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    REQUIRE(time.elapsed() >= 5);
+    time.restart();
+    REQUIRE(time.elapsed() < 5);
+}
@@ -1 +1,108 @@
 #include "tt.h"
+#include <algorithm>
+#include <climits>
+
+namespace lesschess {
+
+bool TT::probe(u64 hash, Entry& entry) noexcept
+{
+    Bucket& b = bucket(hash);
+    for (auto& slot : b.slots) {
+        u64 data = slot.data.load(std::memory_order_relaxed);
+        u64 key  = slot.key.load(std::memory_order_relaxed);
+        if ((key ^ data) == hash && data_flag(data) != Flag::kInvalid) {
+            // refresh the generation so the entry survives replacement this
+            // search. Only the first hit per search writes, so repeated probes
+            // don't keep bouncing the cache line between threads.
+            if (data_generation(data) != generation) {
+                data = (data & ~(static_cast<u64>(GenerationMask) << 58)) |
+                       (static_cast<u64>(generation) << 58);
+                slot.data.store(data, std::memory_order_relaxed);
+                slot.key.store(hash ^ data, std::memory_order_relaxed);
+            }
+            entry = unpack(data);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TT::store(u64 hash, Flag flag, int depth, int value, Move move) noexcept
+{
+    // replacement policy:
+    //   1. same position, or an empty slot
+    //   2. otherwise the slot with the lowest depth, where each search
+    //      generation of age counts as 8 plies of depth
+    Bucket& b = bucket(hash);
+    Slot* replace = nullptr;
+    u64 replace_data = 0;
+    bool same = false;
+    int worst = INT_MAX;
+    for (auto& slot : b.slots) {
+        u64 data = slot.data.load(std::memory_order_relaxed);
+        u64 key  = slot.key.load(std::memory_order_relaxed);
+        if ((key ^ data) == hash || data_flag(data) == Flag::kInvalid) {
+            replace = &slot;
+            replace_data = data;
+            same = (key ^ data) == hash;
+            break;
+        }
+        int age = (generation - data_generation(data)) & GenerationMask;
+        int worth = data_depth(data) - 8*age;
+        if (worth < worst) {
+            worst = worth;
+            replace = &slot;
+        }
+    }
+    assert(replace != nullptr);
+
+    // don't throw away a known best move when this search didn't find one
+    if (move == MOVE_NONE && same && data_flag(replace_data) != Flag::kInvalid) {
+        move = unpack(replace_data).move;
+    }
+
+    const u64 data = pack(flag, depth, value, move, generation);
+    replace->data.store(data, std::memory_order_relaxed);
+    replace->key.store(hash ^ data, std::memory_order_relaxed);
+}
+
+void TT::resize(size_t mb)
+{
+    mb = std::clamp(mb, MinSizeMB, MaxSizeMB);
+    size_t nbuckets = 1;
+    while (2 * nbuckets * sizeof(Bucket) <= mb * 1024 * 1024) {
+        nbuckets *= 2;
+    }
+    buckets = std::vector<Bucket>(nbuckets);
+    mask = nbuckets - 1;
+    clear();
+}
+
+void TT::clear() noexcept
+{
+    const u64 empty = pack(Flag::kInvalid, 0, 0, MOVE_NONE, 0);
+    for (auto& b : buckets) {
+        for (auto& slot : b.slots) {
+            slot.data.store(empty, std::memory_order_relaxed);
+            slot.key.store(empty, std::memory_order_relaxed);
+        }
+    }
+    generation = 0;
+}
+
+int TT::hashfull() const noexcept
+{
+    const size_t nbuckets = std::min<size_t>(1000 / BucketSize, buckets.size());
+    int used = 0;
+    for (size_t i = 0; i < nbuckets; ++i) {
+        for (auto& slot : buckets[i].slots) {
+            u64 data = slot.data.load(std::memory_order_relaxed);
+            if (data_flag(data) != Flag::kInvalid && data_generation(data) == generation) {
+                ++used;
+            }
+        }
+    }
+    return static_cast<int>(1000 * used / (nbuckets * BucketSize));
+}
+
+} // ~namespace lesschess
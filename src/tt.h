@@ -1,19 +1,21 @@
 #pragma once
 
 #include "move.h"
-
-#define TT_UNORDERED_MAP
-#if   defined(TT_UNORDERED_MAP)
-#include <unordered_map>
-#elif defined(TT_KHASH)
-// TODO: implement
-#include "khash.h"
-#else
-#error "Must choose a hash table implementation"
-#endif
+#include <array>
+#include <atomic>
+#include <vector>
 
 namespace lesschess {
 
+// Fixed size transposition table. The table is a power-of-two number of
+// 64-byte buckets so that a probe touches exactly one cache line. Each
+// bucket holds `BucketSize` slots of (key, data), where data packs the
+// value, best move, depth, bound and the search generation that wrote it.
+//
+// The table is shared by all search threads without locking. Each slot
+// stores `key ^ data` instead of the key, so a slot torn by two threads
+// writing at the same time fails verification on probe instead of
+// returning another position's data.
 struct TT {
     enum class Flag : u8 {
         kExact,
@@ -22,8 +24,12 @@ struct TT {
         kInvalid,
     };
 
-    TT(size_t numEntries=(1u << 12))
-    { table.reserve(numEntries); }
+    constexpr static size_t DefaultSizeMB = 16;
+    constexpr static size_t MinSizeMB = 1;
+    constexpr static size_t MaxSizeMB = 4096;
+
+    TT(size_t mb=DefaultSizeMB)
+    { resize(mb); }
 
     struct Entry {
 
@@ -41,22 +47,99 @@ struct TT {
 
         constexpr Entry() noexcept = default;
 
-        constexpr Entry(Flag flag, int value, int depth) noexcept
-            : flag{flag}, value{value}, depth{static_cast<u8>(depth)} {}
+        constexpr Entry(Flag flag, int value, int depth, Move move=MOVE_NONE) noexcept
+            : flag{flag}, depth{static_cast<u8>(depth)}, value{value}, move{move} {}
 
         Flag flag = Flag::kInvalid;
         u8   depth = 0;
         int  value = 0;
+        Move move = MOVE_NONE;
     };
 
-    Entry& find(u64 hash) noexcept { return table[hash]; }
-
-    void clear() noexcept { table.clear(); hits = 0; }
-
-    void record_hit() noexcept { ++hits; }
+    // Look up `hash`, returns true and fills in `entry` on a hit.
+    bool probe(u64 hash, Entry& entry) noexcept;
+
+    void store(u64 hash, Flag flag, int depth, int value, Move move) noexcept;
+
+    // Key for searching the position `hash` with the move `excluded` left
+    // out (singular extensions), so that search neither hits nor overwrites
+    // the entry of the full position.
+    static u64 excluded_key(u64 hash, Move excluded) noexcept
+    { return hash ^ ((static_cast<u64>(excluded.value()) + 1) * 0x9e3779b97f4a7c15ull); }
+
+    // Reallocate the table to the largest power-of-two number of buckets
+    // that fits in `mb` megabytes. Clears all entries.
+    void resize(size_t mb);
+
+    void clear() noexcept;
+
+    // Called at the start of each search, before any search thread is
+    // started, so entries from old searches are
+    // preferred for replacement.
+    void new_search() noexcept
+    { generation = (generation + 1) & GenerationMask; }
+
+    // Approximate permill of the table used by the current search (UCI "hashfull").
+    int hashfull() const noexcept;
+
+    size_t size_in_bytes() const noexcept
+    { return buckets.size() * sizeof(Bucket); }
+
+    //
+    // data layout:
+    //   bits  0-31: value
+    //   bits 32-47: move
+    //   bits 48-55: depth
+    //   bits 56-57: flag
+    //   bits 58-63: generation
+    //
+    constexpr static int BucketSize = 4;
+    constexpr static u8  GenerationMask = 0x3f;
+
+    struct Slot {
+        std::atomic<u64> key; // hash ^ data
+        std::atomic<u64> data;
+    };
 
-    std::unordered_map<u64, Entry> table;
-    s64 hits = 0;
+    struct alignas(64) Bucket {
+        std::array<Slot, BucketSize> slots;
+    };
+    static_assert(sizeof(Bucket) == 64, "bucket must be exactly one cache line");
+
+    static u64 pack(Flag flag, int depth, int value, Move move, u8 generation) noexcept
+    {
+        return (static_cast<u64>(static_cast<u32>(value))          <<  0) |
+               (static_cast<u64>(move.value())                     << 32) |
+               (static_cast<u64>(static_cast<u8>(depth))           << 48) |
+               (static_cast<u64>(static_cast<u8>(flag) & 0x3)      << 56) |
+               (static_cast<u64>(generation & GenerationMask)      << 58);
+    }
+
+    static Entry unpack(u64 data) noexcept
+    {
+        Entry entry;
+        entry.value = static_cast<int>(static_cast<u32>(data & 0xffffffffull));
+        entry.move  = Move::_make_from_u16(static_cast<u16>((data >> 32) & 0xffff));
+        entry.depth = static_cast<u8>((data >> 48) & 0xff);
+        entry.flag  = static_cast<Flag>((data >> 56) & 0x3);
+        return entry;
+    }
+
+    static u8 data_generation(u64 data) noexcept
+    { return static_cast<u8>((data >> 58) & GenerationMask); }
+
+    static Flag data_flag(u64 data) noexcept
+    { return static_cast<Flag>((data >> 56) & 0x3); }
+
+    static u8 data_depth(u64 data) noexcept
+    { return static_cast<u8>((data >> 48) & 0xff); }
+
+    Bucket& bucket(u64 hash) noexcept
+    { return buckets[hash & mask]; }
+
+    std::vector<Bucket> buckets;
+    u64 mask = 0;
+    u8  generation = 0;
 };
 
 } // ~namespace lesschess
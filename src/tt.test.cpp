@@ -0,0 +1,116 @@
+#include "catch.hpp"
+#include "tt.h"
+
+using namespace lesschess;
+
+TEST_CASE("TT size", "[tt]")
+{
+    TT tt{1};
+    REQUIRE(tt.size_in_bytes() == 1024 * 1024);
+    REQUIRE(sizeof(TT::Bucket) == 64);
+
+    tt.resize(3);
+    REQUIRE(tt.size_in_bytes() == 2 * 1024 * 1024);
+
+    tt.resize(0);
+    REQUIRE(tt.size_in_bytes() == TT::MinSizeMB * 1024 * 1024);
+}
+
+TEST_CASE("TT store and probe", "[tt]")
+{
+    TT tt{1};
+    TT::Entry entry;
+    const u64 hash = 0x123456789abcdefull;
+    const Move move = Move::make_promotion(E7, E8, QUEEN);
+
+    REQUIRE(tt.probe(hash, entry) == false);
+
+    tt.store(hash, TT::Flag::kLower, 7, -1234, move);
+    REQUIRE(tt.probe(hash, entry) == true);
+    REQUIRE(entry.is_lower());
+    REQUIRE(entry.depth == 7);
+    REQUIRE(entry.value == -1234);
+    REQUIRE(entry.move == move);
+
+    // different position mapping to the same bucket
+    REQUIRE(tt.probe(hash ^ (1ull << 63), entry) == false);
+
+    // storing without a best move keeps the previous one
+    tt.store(hash, TT::Flag::kUpper, 8, 55, MOVE_NONE);
+    REQUIRE(tt.probe(hash, entry) == true);
+    REQUIRE(entry.is_upper());
+    REQUIRE(entry.depth == 8);
+    REQUIRE(entry.value == 55);
+    REQUIRE(entry.move == move);
+
+    // a slot whose data was overwritten without its key (two threads
+    // racing on the same slot) must not verify
+    for (auto& slot : tt.bucket(hash).slots) {
+        slot.data.store(TT::pack(TT::Flag::kExact, 3, 1, MOVE_NONE, 0));
+    }
+    REQUIRE(tt.probe(hash, entry) == false);
+
+    tt.clear();
+    REQUIRE(tt.probe(hash, entry) == false);
+}
+
+TEST_CASE("TT excluded move keys", "[tt]")
+{
+    TT tt{1};
+    TT::Entry entry;
+    const u64 hash = 0x123456789abcdefull;
+    const Move move = Move(E2, E4);
+    const u64 excluded = TT::excluded_key(hash, move);
+
+    REQUIRE(excluded != hash);
+    REQUIRE(excluded != TT::excluded_key(hash, Move(D2, D4)));
+
+    tt.store(hash, TT::Flag::kLower, 7, 100, move);
+    REQUIRE(tt.probe(excluded, entry) == false);
+
+    tt.store(excluded, TT::Flag::kUpper, 3, -50, Move(D2, D4));
+    REQUIRE(tt.probe(hash, entry) == true);
+    REQUIRE(entry.is_lower());
+    REQUIRE(entry.move == move);
+    REQUIRE(tt.probe(excluded, entry) == true);
+    REQUIRE(entry.is_upper());
+}
+
+TEST_CASE("TT replacement", "[tt]")
+{
+    TT tt{1};
+    TT::Entry entry;
+    const u64 base = 0x42;
+    const u64 stride = tt.mask + 1; // same bucket, different key
+
+    // fill the bucket, the shallowest entry should be replaced first
+    for (int i = 0; i < TT::BucketSize; ++i) {
+        tt.store(base + i*stride, TT::Flag::kExact, 10 + i, i, MOVE_NONE);
+    }
+    tt.store(base + TT::BucketSize*stride, TT::Flag::kExact, 1, 99, MOVE_NONE);
+    REQUIRE(tt.probe(base, entry) == false);
+    for (int i = 1; i <= TT::BucketSize; ++i) {
+        REQUIRE(tt.probe(base + i*stride, entry) == true);
+    }
+
+    // entries from older searches go before deeper entries from this one
+    tt.new_search();
+    tt.store(base + 2*stride, TT::Flag::kExact, 11, 0, MOVE_NONE);
+    tt.store(base + 3*stride, TT::Flag::kExact, 12, 0, MOVE_NONE);
+    tt.store(base + 4*stride, TT::Flag::kExact, 5, 0, MOVE_NONE);
+    tt.store(base, TT::Flag::kExact, 1, 0, MOVE_NONE);
+    REQUIRE(tt.probe(base + stride, entry) == false);
+    REQUIRE(tt.probe(base, entry) == true);
+    REQUIRE(tt.probe(base + 2*stride, entry) == true);
+    REQUIRE(tt.probe(base + 3*stride, entry) == true);
+    REQUIRE(tt.probe(base + 4*stride, entry) == true);
+
+    // probing an entry from an older search moves it to this one, so the
+    // shallow entry that was just probed outlives the deeper stale one
+    tt.new_search();
+    REQUIRE(tt.probe(base, entry) == true);
+    REQUIRE(tt.probe(base, entry) == true);
+    tt.store(base + stride, TT::Flag::kExact, 30, 0, MOVE_NONE);
+    REQUIRE(tt.probe(base, entry) == true);
+    REQUIRE(tt.probe(base + 4*stride, entry) == false);
+}